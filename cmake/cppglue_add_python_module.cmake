@@ -0,0 +1,82 @@
+# This function runs py-gen as a build step and builds the Python module it generates.
+#
+# Usage:
+#   cppglue_add_python_module(name CONFIG config.toml
+#                             [OUTPUT_DIR dir] [WORKING_DIRECTORY dir] [PY_GEN executable]
+#                             [ARGS args...] [DEPENDS files...] [NO_MODULE])
+#
+# Parameters:
+#   name              - The module_name of the config (of its first module, with [[modules]]), also the target name.
+#   CONFIG            - The py-gen config file.
+#   OUTPUT_DIR        - The output_dir of that module, relative to WORKING_DIRECTORY (default: ".").
+#   WORKING_DIRECTORY - The directory py-gen runs in, the relative paths of the config are resolved against it
+#                       (default: the directory of CONFIG).
+#   PY_GEN            - The py-gen executable (default: the py-gen target if the project builds it, else found on the PATH).
+#   ARGS              - Further py-gen arguments, e.g. --instrument.
+#   DEPENDS           - Further files or targets the generation depends on, e.g. the target generating a bound header.
+#   NO_MODULE         - Only generate, adds the target <name>_bindings instead of building the module.
+#
+# What it does:
+# - Adds a custom command writing <OUTPUT_DIR>/<name>.cpp. py-gen writes a depfile listing the config, the sources,
+#   every header they include and the customized templates, so the bindings are regenerated when, and only when, one
+#   of them changed.
+# - Adds the module <name> built from the generated source with pybind11_add_module(), if pybind11 is available. Add
+#   the include directories and libraries of the bound headers to it as for any other target.
+#
+# py-gen leaves unchanged outputs untouched, the command touches <name>.cpp so the build sees it as up to date. The
+# sources written with shard_bindings (or pipeline) are only known after generating, use a plain config.
+# Depfiles of custom commands need CMake 3.20 with the Makefile generators.
+function(cppglue_add_python_module name)
+  cmake_parse_arguments(PARSE_ARGV 1 ARG "NO_MODULE" "CONFIG;OUTPUT_DIR;WORKING_DIRECTORY;PY_GEN" "ARGS;DEPENDS")
+  if(NOT ARG_CONFIG)
+    message(FATAL_ERROR "cppglue_add_python_module(${name}): CONFIG is required")
+  endif()
+
+  get_filename_component(config "${ARG_CONFIG}" ABSOLUTE)
+  if(NOT ARG_WORKING_DIRECTORY)
+    get_filename_component(ARG_WORKING_DIRECTORY "${config}" DIRECTORY)
+  endif()
+  if(NOT ARG_OUTPUT_DIR)
+    set(ARG_OUTPUT_DIR ".")
+  endif()
+  get_filename_component(output_dir "${ARG_OUTPUT_DIR}" ABSOLUTE BASE_DIR "${ARG_WORKING_DIRECTORY}")
+
+  if(NOT ARG_PY_GEN)
+    if(TARGET py-gen)
+      set(ARG_PY_GEN py-gen)
+    else()
+      find_program(CPPGLUE_PY_GEN_EXECUTABLE py-gen REQUIRED)
+      set(ARG_PY_GEN ${CPPGLUE_PY_GEN_EXECUTABLE})
+    endif()
+  endif()
+  # A target as the command also makes the generation depend on building it
+  if(TARGET ${ARG_PY_GEN})
+    list(APPEND ARG_DEPENDS ${ARG_PY_GEN})
+  endif()
+
+  set(bindings "${output_dir}/${name}.cpp")
+  set(depfile "${CMAKE_CURRENT_BINARY_DIR}/${name}.d")
+
+  # Depfile paths relative to the binary directory of the command, not the top level one
+  cmake_policy(PUSH)
+  if(POLICY CMP0116)
+    cmake_policy(SET CMP0116 NEW)
+  endif()
+  add_custom_command(
+    OUTPUT "${bindings}"
+    COMMAND ${ARG_PY_GEN} -c "${config}" --depfile "${depfile}" --no-print ${ARG_ARGS}
+    COMMAND ${CMAKE_COMMAND} -E touch "${bindings}"
+    DEPENDS "${config}" ${ARG_DEPENDS}
+    DEPFILE "${depfile}"
+    WORKING_DIRECTORY "${ARG_WORKING_DIRECTORY}"
+    COMMENT "Generating Python bindings ${name}"
+    VERBATIM)
+  cmake_policy(POP)
+
+  if(NOT ARG_NO_MODULE AND COMMAND pybind11_add_module)
+    pybind11_add_module(${name} "${bindings}")
+    target_include_directories(${name} PRIVATE "${output_dir}")
+  else()
+    add_custom_target(${name}_bindings DEPENDS "${bindings}")
+  endif()
+endfunction()
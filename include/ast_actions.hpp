@@ -15,7 +15,8 @@
 
 class ASTConsumer : public clang::ASTConsumer {
   public:
-    explicit ASTConsumer(clang::ASTContext *context, VisitCompleteCallback cb) : visitor_(context, cb) {}
+    explicit ASTConsumer(clang::ASTContext *context, VisitCompleteCallback cb, const DeclarationFilter *filter = nullptr)
+        : visitor_(context, cb, filter) {}
 
     void HandleTranslationUnit(clang::ASTContext &context) override { visitor_.TraverseDecl(context.getTranslationUnitDecl()); }
 
@@ -27,7 +28,9 @@ class ASTConsumer : public clang::ASTConsumer {
 
 class DeclarationExtractorAction : public clang::ASTFrontendAction {
   public:
-    explicit DeclarationExtractorAction(VisitCompleteCallback cb, HeaderCallback hcb) : cb_(std::move(cb)), hcb_(hcb) {}
+    explicit DeclarationExtractorAction(VisitCompleteCallback cb, HeaderCallback hcb,
+                                        std::shared_ptr<const DeclarationFilter> filter = nullptr)
+        : cb_(std::move(cb)), hcb_(hcb), filter_(std::move(filter)) {}
 
     bool BeginSourceFileAction(clang::CompilerInstance &CI) override {
         // Create and register the IncludeTracker with the SourceManager
@@ -44,32 +47,36 @@ class DeclarationExtractorAction : public clang::ASTFrontendAction {
             hcb_({{.name = fileName.str(), .fullPath = file.str(), .isSystem = false, .isInputFile = true}});
         }
 
-        consumer_ = new ASTConsumer(&compiler.getASTContext(), cb_);
+        consumer_ = new ASTConsumer(&compiler.getASTContext(), cb_, filter_.get());
         return std::unique_ptr<clang::ASTConsumer>(consumer_);
     }
 
     ~DeclarationExtractorAction() override = default;
 
   private:
-    VisitCompleteCallback cb_;
-    HeaderCallback        hcb_;
-    ASTConsumer          *consumer_{};
+    VisitCompleteCallback                    cb_;
+    HeaderCallback                           hcb_;
+    std::shared_ptr<const DeclarationFilter> filter_;
+    ASTConsumer                             *consumer_{};
 };
 
 // Create an action factory
 class DeclarationExtractionActionFactory : public clang::tooling::FrontendActionFactory {
   public:
-    explicit DeclarationExtractionActionFactory(VisitCompleteCallback cb, HeaderCallback hcb) : cb_(std::move(cb)), hcb_(std::move(hcb)) {}
+    explicit DeclarationExtractionActionFactory(VisitCompleteCallback cb, HeaderCallback hcb,
+                                                std::shared_ptr<const DeclarationFilter> filter = nullptr)
+        : cb_(std::move(cb)), hcb_(std::move(hcb)), filter_(std::move(filter)) {}
 
     std::unique_ptr<clang::FrontendAction> create() override {
-        action_ = new DeclarationExtractorAction(cb_, hcb_);
+        action_ = new DeclarationExtractorAction(cb_, hcb_, filter_);
         return std::unique_ptr<clang::FrontendAction>(action_);
     }
 
     ~DeclarationExtractionActionFactory() override = default;
 
   private:
-    VisitCompleteCallback       cb_;
-    HeaderCallback              hcb_;
-    DeclarationExtractorAction *action_;
+    VisitCompleteCallback                    cb_;
+    HeaderCallback                           hcb_;
+    std::shared_ptr<const DeclarationFilter> filter_;
+    DeclarationExtractorAction              *action_;
 };
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <clang/Basic/Specifiers.h>
+#include <map>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Include/exclude rules as written in the config, compiled into a DeclarationFilter.
+ *
+ * - Namespaces are qualified scope prefixes, "a::b" covers a::b and everything inside it. The most specific rule
+ *   wins, so "a" can be included while "a::detail" is excluded. If any include rule exists, names outside of all
+ *   included scopes are excluded.
+ * - Names are globs on the qualified name, `*` and `?` stay within one scope, `**` crosses scopes.
+ * - Regexes are searched in the qualified name.
+ * - Headers are globs on the real path of the defining file, `*` and `?` stay within one directory, `**` does not.
+ * For names, regexes and headers an exclude match always excludes, and if include rules exist one of them has to match.
+ */
+struct DeclarationFilterRules {
+    std::vector<std::string> includeNamespaces;
+    std::vector<std::string> excludeNamespaces;
+    std::vector<std::string> includeNames;
+    std::vector<std::string> excludeNames;
+    std::vector<std::string> includeRegexes;
+    std::vector<std::string> excludeRegexes;
+    std::vector<std::string> includeHeaders;
+    std::vector<std::string> excludeHeaders;
+    bool                     publicOnly{false}; // Skip private and protected members, methods and nested types
+};
+
+/**
+ * @brief Translates a glob into regex syntax, `*` and `?` do not match the separator, `**` does.
+ */
+inline std::string globToRegexPattern(std::string_view glob, char separator) {
+    std::string pattern;
+    std::string notSeparator = std::string("[^") + separator + "]";
+    for (size_t i = 0; i < glob.size(); ++i) {
+        char c = glob[i];
+        if (c == '*') {
+            if (i + 1 < glob.size() && glob[i + 1] == '*') {
+                pattern += ".*";
+                ++i;
+            } else {
+                pattern += notSeparator + "*";
+            }
+        } else if (c == '?') {
+            pattern += notSeparator;
+        } else if (std::string_view("\\^$.|+()[]{}").find(c) != std::string_view::npos) {
+            pattern += '\\';
+            pattern += c;
+        } else {
+            pattern += c;
+        }
+    }
+    return pattern;
+}
+
+/**
+ * @brief Rules compiled once and evaluated for every declaration during traversal.
+ *
+ * Namespace rules live in a trie of scope segments, so a lookup is one walk over the segments of the name. All
+ * globs and regexes of one kind are merged into a single precompiled alternation. The Visitor asks prunesScope()
+ * before descending into a namespace or record, so excluded subtrees are never visited at all.
+ * @throws std::regex_error on invalid patterns
+ */
+class DeclarationFilter {
+  public:
+    explicit DeclarationFilter(const DeclarationFilterRules &rules) : publicOnly_(rules.publicOnly) {
+        for (const auto &scope : rules.includeNamespaces) {
+            insertScope(scope, Decision::Include);
+        }
+        for (const auto &scope : rules.excludeNamespaces) {
+            insertScope(scope, Decision::Exclude);
+        }
+        hasIncludeScopes_ = !rules.includeNamespaces.empty();
+
+        std::vector<std::string> includeNames = rules.includeRegexes;
+        std::vector<std::string> excludeNames = rules.excludeRegexes;
+        for (const auto &glob : rules.includeNames) {
+            includeNames.push_back("^" + globToRegexPattern(glob, ':') + "$");
+        }
+        for (const auto &glob : rules.excludeNames) {
+            excludeNames.push_back("^" + globToRegexPattern(glob, ':') + "$");
+        }
+        includeNames_ = compileAlternation(includeNames);
+        excludeNames_ = compileAlternation(excludeNames);
+
+        std::vector<std::string> includeHeaders;
+        std::vector<std::string> excludeHeaders;
+        for (const auto &glob : rules.includeHeaders) {
+            includeHeaders.push_back(globToRegexPattern(glob, '/'));
+        }
+        for (const auto &glob : rules.excludeHeaders) {
+            excludeHeaders.push_back(globToRegexPattern(glob, '/'));
+        }
+        includeHeaders_ = compileAlternation(includeHeaders);
+        excludeHeaders_ = compileAlternation(excludeHeaders);
+    }
+
+    /**
+     * @brief Whether a declaration with the given qualified name, defined in the given file, is selected.
+     */
+    [[nodiscard]] bool accepts(std::string_view qualifiedName, std::string_view definingFile) const {
+        auto decision = lookupScope(qualifiedName).decision;
+        if (decision == Decision::Exclude || (decision == Decision::None && hasIncludeScopes_)) {
+            return false;
+        }
+
+        if (excludeNames_ && std::regex_search(qualifiedName.begin(), qualifiedName.end(), *excludeNames_)) {
+            return false;
+        }
+        if (includeNames_ && !std::regex_search(qualifiedName.begin(), qualifiedName.end(), *includeNames_)) {
+            return false;
+        }
+
+        if (excludeHeaders_ && std::regex_match(definingFile.begin(), definingFile.end(), *excludeHeaders_)) {
+            return false;
+        }
+        if (includeHeaders_ && !std::regex_match(definingFile.begin(), definingFile.end(), *includeHeaders_)) {
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Whether nothing inside the given scope (namespace or record) can be selected, so it need not be traversed.
+     */
+    [[nodiscard]] bool prunesScope(std::string_view qualifiedScope) const {
+        auto match    = lookupScope(qualifiedScope);
+        bool excluded = match.decision == Decision::Exclude || (match.decision == Decision::None && hasIncludeScopes_);
+        return excluded && !match.includeBelow;
+    }
+
+    [[nodiscard]] bool acceptsAccess(clang::AccessSpecifier access) const {
+        return !publicOnly_ || access == clang::AS_public || access == clang::AS_none;
+    }
+
+  private:
+    enum class Decision { None, Include, Exclude };
+
+    struct Node {
+        std::map<std::string, size_t, std::less<>> children;
+        Decision                                    decision{Decision::None};
+        bool                                        includeBelow{false}; // Some descendant scope is included
+    };
+
+    struct ScopeMatch {
+        Decision decision{Decision::None}; // Decision of the most specific rule covering the name
+        bool     includeBelow{false};      // The name is a scope containing more specific include rules
+    };
+
+    template <typename Visit> static void forEachSegment(std::string_view qualifiedName, Visit &&visit) {
+        while (!qualifiedName.empty()) {
+            auto end = qualifiedName.find("::");
+            if (!visit(qualifiedName.substr(0, end)) || end == std::string_view::npos) {
+                return;
+            }
+            qualifiedName.remove_prefix(end + 2);
+        }
+    }
+
+    void insertScope(std::string_view scope, Decision decision) {
+        size_t node = 0;
+        forEachSegment(scope, [this, &node, decision](std::string_view segment) {
+            if (decision == Decision::Include) {
+                nodes_[node].includeBelow = true;
+            }
+
+            auto it = nodes_[node].children.find(segment);
+            if (it != nodes_[node].children.end()) {
+                node = it->second;
+                return true;
+            }
+
+            auto child = nodes_.size();
+            nodes_[node].children.emplace(std::string(segment), child);
+            nodes_.emplace_back();
+            node = child;
+            return true;
+        });
+        nodes_[node].decision = decision;
+    }
+
+    [[nodiscard]] ScopeMatch lookupScope(std::string_view qualifiedName) const {
+        ScopeMatch match;
+        size_t     node      = 0;
+        bool       fullMatch = true;
+        forEachSegment(qualifiedName, [this, &match, &node, &fullMatch](std::string_view segment) {
+            auto it = nodes_[node].children.find(segment);
+            if (it == nodes_[node].children.end()) {
+                fullMatch = false;
+                return false;
+            }
+            node = it->second;
+            if (nodes_[node].decision != Decision::None) {
+                match.decision = nodes_[node].decision;
+            }
+            return true;
+        });
+        match.includeBelow = fullMatch && nodes_[node].includeBelow;
+        return match;
+    }
+
+    static std::optional<std::regex> compileAlternation(const std::vector<std::string> &patterns) {
+        if (patterns.empty()) {
+            return std::nullopt;
+        }
+
+        std::string alternation;
+        for (const auto &pattern : patterns) {
+            alternation += (alternation.empty() ? "(?:" : "|(?:") + pattern + ")";
+        }
+        return std::regex(alternation, std::regex::optimize);
+    }
+
+    std::vector<Node>         nodes_{1};
+    bool                      hasIncludeScopes_{false};
+    bool                      publicOnly_{false};
+    std::optional<std::regex> includeNames_;
+    std::optional<std::regex> excludeNames_;
+    std::optional<std::regex> includeHeaders_;
+    std::optional<std::regex> excludeHeaders_;
+};
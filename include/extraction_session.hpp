@@ -0,0 +1,313 @@
+#pragma once
+
+#include "ast_actions.hpp"
+#include "declaration_filter.hpp"
+#include "include_tracker.hpp"
+#include "visitor.hpp"
+
+#include <algorithm>
+#include <clang/Basic/FileManager.h>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <clang/Tooling/JSONCompilationDatabase.h>
+#include <clang/Tooling/Tooling.h>
+#include <filesystem>
+#include <fmt/format.h>
+#include <functional>
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Everything needed to run one extraction over a set of sources.
+ *
+ * Either compileArgs (applied to every source) or compileCommandsFile is used to build the compilation database.
+ * If sources is empty and a compile_commands.json is given, all files in the database are processed.
+ * With shardCount > 1 only every shardCount-th source (in sorted order) starting at shardIndex is processed, so N
+ * processes given the same request and the indices 0..N-1 split the sources between them without overlap.
+ * Instantiations are extracted from one additional in-memory source (by shard 0), see instantiationSource().
+ */
+struct ExtractionRequest {
+    std::vector<std::string> sources;
+    std::vector<std::string> compileArgs;
+    std::string              compileCommandsFile;
+    std::string              workingDirectory = std::filesystem::current_path().string();
+    size_t                   shardIndex{0};
+    size_t                   shardCount{1};
+
+    std::vector<Instantiation> instantiations;     // Class template instantiations extracted as structs of their own
+    bool                       instantiationsOnly{false}; // Parse only the instantiations, the sources just provide headers
+
+    std::shared_ptr<const DeclarationFilter> filter; // Applied during traversal, nullptr extracts all user declarations
+};
+
+/**
+ * @brief Runs extractions while keeping clang's file system state alive between runs.
+ *
+ * A one-shot tool pays for every stat(), FileEntry lookup and file read again on each invocation. The session keeps
+ * one FileManager and the contents of every file read through it (see ContentCache) per working directory, so
+ * repeated requests, e.g. from the py-gen server, neither stat nor read the same headers again. That includes PCH
+ * files named by the compile args, which clang reads through the same file system; the ASTs are still deserialized
+ * per translation unit. Before each run every file stat'ed or read is checked against the file system and both caches
+ * for that directory are dropped if any file was replaced or changed size or modification time (see
+ * ContentCache::isStale()).
+ *
+ * Only file system state is shared between translation units. Each source gets its own CompilerInstance (clang's
+ * tooling runs it with DisableFree off), so its ASTContext, source buffers and IncludeTracker are destroyed as soon
+ * as the Visitor and the callbacks returned, before the next source is parsed. Use IRCollector to keep the results
+ * bounded as well.
+ */
+class ExtractionSession {
+  public:
+    int run(const ExtractionRequest &request, VisitCompleteCallback cb, HeaderCallback hcb) {
+        std::string                                          error;
+        std::unique_ptr<clang::tooling::CompilationDatabase> database;
+        if (!request.compileCommandsFile.empty()) {
+            database = clang::tooling::JSONCompilationDatabase::loadFromFile(request.compileCommandsFile, error,
+                                                                             clang::tooling::JSONCommandLineSyntax::AutoDetect);
+        } else {
+            database = std::make_unique<clang::tooling::FixedCompilationDatabase>(request.workingDirectory, request.compileArgs);
+        }
+
+        if (!database) {
+            llvm::errs() << "Error loading compilation database: " << error << "\n";
+            return 1;
+        }
+
+        auto sources = request.sources;
+        if (sources.empty() && !request.compileCommandsFile.empty()) {
+            sources = database->getAllFiles();
+        }
+        if (request.shardCount > 1) {
+            sources = shard(std::move(sources), request.shardIndex, request.shardCount);
+        }
+
+        if (request.instantiationsOnly) {
+            sources.clear();
+        }
+
+        auto &state = warmStateFor(request.workingDirectory);
+
+        // The instantiations are parsed as one more, in-memory source, which has no compile command in a database
+        if (!request.instantiations.empty() && request.shardIndex == 0) {
+            auto content = instantiationSource(request);
+            if (content.empty()) {
+                llvm::errs() << "No header declares the instantiations, give their header or list the headers as sources\n";
+            } else {
+                // Named after the content, so a changed config never meets a stale buffer of the same name
+                auto path = std::filesystem::path(request.workingDirectory) /
+                            fmt::format("{}{:016x}.cpp", instantiationFilePrefix, std::hash<std::string>{}(content));
+                state.memory->addFile(path.string(), 0, llvm::MemoryBuffer::getMemBufferCopy(content));
+                sources.push_back(path.string());
+                if (!request.compileCommandsFile.empty()) {
+                    database = clang::tooling::inferMissingCompileCommands(std::move(database));
+                }
+            }
+        }
+        if (sources.empty()) {
+            return 0;
+        }
+
+        clang::tooling::ClangTool          tool(*database, sources, pchOperations_, state.fileSystem, state.files);
+        DeclarationExtractionActionFactory factory(std::move(cb), std::move(hcb), request.filter);
+        return tool.run(&factory);
+    }
+
+    /**
+     * @brief Drops all cached file system state.
+     */
+    void reset() { warm_.clear(); }
+
+    /**
+     * @brief Drops the cached file system state of one working directory, e.g. once files are known to have changed.
+     */
+    void reset(const std::string &workingDirectory) { warm_.erase(workingDirectory); }
+
+    /**
+     * @brief File name prefix of the in-memory sources declaring the instantiations, see instantiationSource().
+     */
+    static constexpr std::string_view instantiationFilePrefix = "cppglue_instantiations_";
+
+    /**
+     * @brief The source completing every requested instantiation, empty if there is no header to include.
+     *
+     * Each instantiation becomes an alias in the instantiation namespace, named like the Python type. Completing the
+     * alias with sizeof instantiates the class and the declarations of its members (not their definitions, so members
+     * that would not compile for the arguments are no problem unless they are bound), which the Visitor extracts.
+     */
+    static std::string instantiationSource(const ExtractionRequest &request) {
+        auto absolute = [&request](const std::string &path) {
+            return std::filesystem::path(path).is_absolute() ? path : (std::filesystem::path(request.workingDirectory) / path).string();
+        };
+
+        std::vector<std::string> headers;
+        for (const auto &instantiation : request.instantiations) {
+            if (!instantiation.header.empty()) {
+                headers.push_back(absolute(instantiation.header));
+            }
+        }
+        for (const auto &source : request.sources) {
+            auto extension = std::filesystem::path(source).extension();
+            if (extension == ".h" || extension == ".hpp" || extension == ".hxx" || extension == ".hh") {
+                headers.push_back(absolute(source));
+            }
+        }
+        if (headers.empty()) {
+            return {};
+        }
+        // In the order given, once each
+        std::string           source;
+        std::set<std::string> included;
+        for (const auto &header : headers) {
+            if (included.insert(header).second) {
+                source += "#include \"" + header + "\"\n";
+            }
+        }
+        source += "\nnamespace " + std::string(instantiationNamespace) + " {\n";
+        for (const auto &instantiation : request.instantiations) {
+            auto name = instantiation.pythonName();
+            source += "using " + name + " = " + instantiation.type + ";\n";
+            source += "static_assert(sizeof(" + name + ") > 0);\n";
+        }
+        source += "} // namespace " + std::string(instantiationNamespace) + "\n";
+        return source;
+    }
+
+  private:
+    /**
+     * @brief Round robin over the sorted sources, neighbouring files (often of similar size) end up in different shards.
+     */
+    static std::vector<std::string> shard(std::vector<std::string> sources, size_t index, size_t count) {
+        std::sort(sources.begin(), sources.end());
+        sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+        std::vector<std::string> selected;
+        for (size_t i = index; i < sources.size(); i += count) {
+            selected.push_back(std::move(sources[i]));
+        }
+        return selected;
+    }
+
+    /**
+     * @brief Keeps the contents of every file opened, later opens of the same path are served from memory, and the
+     * status of every regular file stat'ed. Has no invalidation of its own, it is dropped together with the
+     * FileManager of its WarmState once isStale().
+     */
+    class ContentCache : public llvm::vfs::ProxyFileSystem {
+      public:
+        using ProxyFileSystem::ProxyFileSystem;
+
+        llvm::ErrorOr<llvm::vfs::Status> status(const llvm::Twine &path) override {
+            auto status = ProxyFileSystem::status(path);
+            llvm::SmallString<256> key;
+            path.toVector(key);
+            if (status && status->isRegularFile() && !makeAbsolute(key)) {
+                statuses_.try_emplace(key, *status);
+            }
+            return status;
+        }
+
+        llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> openFileForRead(const llvm::Twine &path) override {
+            llvm::SmallString<256> key;
+            path.toVector(key);
+            if (makeAbsolute(key)) {
+                return ProxyFileSystem::openFileForRead(path);
+            }
+
+            auto it = contents_.find(key);
+            if (it == contents_.end()) {
+                auto file = ProxyFileSystem::openFileForRead(path);
+                if (!file) {
+                    return file;
+                }
+                auto status = (*file)->status();
+                auto buffer = (*file)->getBuffer(key);
+                if (!status || !buffer) {
+                    return file;
+                }
+                it = contents_.try_emplace(key, *status, llvm::MemoryBuffer::getMemBufferCopy((*buffer)->getBuffer(), key)).first;
+            }
+            return std::make_unique<CachedFile>(llvm::vfs::Status::copyWithNewName(it->second.first, path), *it->second.second);
+        }
+
+        /**
+         * @brief Whether any file was removed, replaced or modified since its contents or status were cached.
+         *
+         * Stats the absolute paths through the wrapped file system and compares the full status, the modification
+         * time at the precision of the file system (not the seconds the FileManager keeps), so an edit keeping the
+         * size within the same second is noticed as well.
+         * @note Lookups that failed (e.g. include search misses) are cached by the FileManager, a header created later
+         * in an include directory that was searched before is only picked up after reset().
+         */
+        bool isStale() {
+            auto changed = [this](llvm::StringRef path, const llvm::vfs::Status &cached) {
+                auto current = getUnderlyingFS().status(path);
+                return !current || !current->equivalent(cached) || current->getSize() != cached.getSize() ||
+                       current->getLastModificationTime() != cached.getLastModificationTime();
+            };
+            return std::any_of(contents_.begin(), contents_.end(),
+                               [&changed](const auto &entry) { return changed(entry.getKey(), entry.getValue().first); }) ||
+                   std::any_of(statuses_.begin(), statuses_.end(),
+                               [&changed](const auto &entry) { return changed(entry.getKey(), entry.getValue()); });
+        }
+
+      private:
+        class CachedFile : public llvm::vfs::File {
+          public:
+            CachedFile(llvm::vfs::Status status, const llvm::MemoryBuffer &contents) : status_(std::move(status)), contents_(contents) {}
+
+            llvm::ErrorOr<llvm::vfs::Status> status() override { return status_; }
+
+            llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> getBuffer(const llvm::Twine &name, int64_t, bool, bool) override {
+                // The copy in the cache is null terminated, a view of it satisfies every request
+                return llvm::MemoryBuffer::getMemBuffer(contents_.getBuffer(), name.str());
+            }
+
+            std::error_code close() override { return {}; }
+
+          private:
+            llvm::vfs::Status         status_;
+            const llvm::MemoryBuffer &contents_;
+        };
+
+        llvm::StringMap<std::pair<llvm::vfs::Status, std::unique_ptr<llvm::MemoryBuffer>>> contents_;
+        llvm::StringMap<llvm::vfs::Status>                                                  statuses_;
+    };
+
+    struct WarmState {
+        llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>         fileSystem; // The cached physical one, overlaid by memory
+        llvm::IntrusiveRefCntPtr<ContentCache>                  cache;      // The cached physical one
+        llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> memory;     // Generated sources, never stale
+        llvm::IntrusiveRefCntPtr<clang::FileManager>            files;
+    };
+
+    WarmState &warmStateFor(const std::string &workingDirectory) {
+        auto it = warm_.find(workingDirectory);
+        if (it != warm_.end() && !it->second.cache->isStale()) {
+            return it->second;
+        }
+
+        // A physical file system has its own working directory, so sessions for different directories never chdir the process
+        WarmState state;
+        state.memory = llvm::makeIntrusiveRefCnt<llvm::vfs::InMemoryFileSystem>();
+        state.cache  = llvm::makeIntrusiveRefCnt<ContentCache>(
+            llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>(llvm::vfs::createPhysicalFileSystem().release()));
+        auto overlay = llvm::makeIntrusiveRefCnt<llvm::vfs::OverlayFileSystem>(state.cache);
+        overlay->pushOverlay(state.memory);
+        overlay->setCurrentWorkingDirectory(workingDirectory);
+        state.fileSystem = overlay;
+        state.files = llvm::makeIntrusiveRefCnt<clang::FileManager>(clang::FileSystemOptions{}, state.fileSystem);
+
+        return warm_.insert_or_assign(workingDirectory, std::move(state)).first->second;
+    }
+
+    std::shared_ptr<clang::PCHContainerOperations> pchOperations_ = std::make_shared<clang::PCHContainerOperations>();
+    std::map<std::string, WarmState>               warm_;
+};
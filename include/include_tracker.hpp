@@ -2,6 +2,7 @@
 
 #include <clang/Basic/SourceManager.h>
 #include <clang/Lex/PPCallbacks.h>
+#include <llvm/ADT/StringSet.h>
 #include <utility>
 
 struct Header {
@@ -9,6 +10,9 @@ struct Header {
     std::string fullPath;
     bool        isSystem;
     bool        isInputFile;
+    bool        isDirect{true}; // Included by the main file, otherwise reached through another header
+
+    bool operator==(const Header &) const = default;
 };
 
 using Headers = std::vector<Header>;
@@ -37,7 +41,7 @@ class IncludeTracker : public clang::PPCallbacks {
             fullPath = File->getFileEntry().tryGetRealPathName().str();
         }
 
-        // Only process direct includes from the main file
+        // Direct includes are kept as spelled, they are what the generated bindings include
         if (isDirectInclude) {
             headers_.push_back({FileName.str(), fullPath, FileType != clang::SrcMgr::C_User, false});
 
@@ -46,12 +50,16 @@ class IncludeTracker : public clang::PPCallbacks {
             // if (!fullPath.empty()) {
             //     llvm::outs() << "Full path: " << fullPath << "\n";
             // }
+        } else if (!fullPath.empty() && seenTransitive_.insert(fullPath).second) {
+            // Transitive includes are only dependencies (for watching and depfiles), record each file once
+            headers_.push_back({FileName.str(), fullPath, FileType != clang::SrcMgr::C_User, false, false});
         }
     }
 
   private:
     const clang::SourceManager &sourceManager_;
 
-    Headers        headers_;
-    HeaderCallback cb_;
+    Headers           headers_;
+    llvm::StringSet<> seenTransitive_;
+    HeaderCallback    cb_;
 };
\ No newline at end of file
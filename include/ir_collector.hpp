@@ -0,0 +1,283 @@
+#pragma once
+
+#include "include_tracker.hpp"
+#include "ir_json.hpp"
+#include "visitor.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @brief Everything extracted from a set of translation units.
+ */
+struct CollectedIR {
+    Structs   structs;
+    Functions functions;
+    Headers   headers;
+};
+
+/**
+ * @brief Identity of a declaration across translation units, a header's declarations are extracted once per TU
+ * including it.
+ */
+inline std::string declarationKey(const StructInfo &info) { return (info.isEnum ? "enum " : "struct ") + info.name.qualified; }
+
+inline std::string declarationKey(const FunctionInfo &function) {
+    std::string key = function.name.qualified;
+    key += '(';
+    for (const auto &parameter : function.parameters) {
+        key += parameter.type.qualified;
+        key += ',';
+    }
+    key += ')';
+    if (function.isStatic) {
+        key += " static";
+    }
+    if (function.isConst) {
+        key += " const";
+    }
+    return key;
+}
+
+inline std::string declarationKey(const Header &header) {
+    return header.name + '\n' + header.fullPath + '\n' + (header.isSystem ? 's' : '-') + (header.isInputFile ? 'i' : '-') +
+           (header.isDirect ? 'd' : '-');
+}
+
+/**
+ * @brief Rough heap footprint of the IR, used to decide when to spill.
+ */
+inline size_t approximateSize(const DeclarationName &name) {
+    return name.plain.capacity() + name.qualified.capacity() + (name.namespace_ ? name.namespace_->capacity() : 0);
+}
+
+inline size_t approximateSize(const FunctionInfo &function);
+
+inline size_t approximateSize(const FieldDeclarationInfo &field) {
+    size_t size = sizeof(FieldDeclarationInfo) + approximateSize(field.type) + approximateSize(field.name);
+    for (const auto &functional : field.functionals) {
+        size += approximateSize(functional);
+    }
+    return size;
+}
+
+inline size_t approximateSize(const StructInfo &info) {
+    size_t size = sizeof(StructInfo) + approximateSize(info.name) + info.definingFile.capacity();
+    for (const auto &member : info.members) {
+        size += approximateSize(member);
+    }
+    for (const auto &constructor : info.constructors) {
+        size += approximateSize(constructor);
+    }
+    return size;
+}
+
+inline size_t approximateSize(const FunctionInfo &function) {
+    size_t size = sizeof(FunctionInfo) + approximateSize(function.name) + approximateSize(function.returnType) +
+                  function.definingFile.capacity() + (function.parent ? approximateSize(*function.parent) : 0);
+    for (const auto &parameter : function.parameters) {
+        size += approximateSize(parameter);
+    }
+    return size;
+}
+
+inline size_t approximateSize(const Header &header) { return sizeof(Header) + header.name.capacity() + header.fullPath.capacity(); }
+
+/**
+ * @brief Merges the IR of many translation units, dropping the copies of declarations seen in an earlier TU.
+ *
+ * With a memory budget, the collected IR is appended to a spill file (JSON lines, see ir_json.hpp) whenever it grows
+ * beyond the budget, and read back by take() once extraction finished and the last AST is gone. Only the keys of
+ * the declarations seen so far stay in memory, so during extraction the peak is bounded by the largest translation
+ * unit plus the budget instead of growing with the number of sources.
+ */
+class IRCollector {
+  public:
+    struct Options {
+        size_t                memoryBudget{0}; // Bytes of IR kept in memory before spilling, 0 never spills
+        std::filesystem::path spillDirectory;  // Defaults to the system temporary directory
+    };
+
+    IRCollector() = default;
+    explicit IRCollector(Options options) : options_(std::move(options)) {}
+
+    ~IRCollector() { removeSpillFile(); }
+
+    IRCollector(const IRCollector &)            = delete;
+    IRCollector &operator=(const IRCollector &) = delete;
+
+    void addDeclarations(Structs &&structs, Functions &&functions) {
+        for (auto &info : structs) {
+            if (seen_.insert(declarationKey(info)).second) {
+                size_ += approximateSize(info);
+                ir_.structs.push_back(std::move(info));
+            }
+        }
+        for (auto &function : functions) {
+            if (seen_.insert(declarationKey(function)).second) {
+                size_ += approximateSize(function);
+                ir_.functions.push_back(std::move(function));
+            }
+        }
+        spillIfOverBudget();
+    }
+
+    void addHeaders(Headers &&headers) {
+        for (auto &header : headers) {
+            if (seen_.insert(declarationKey(header)).second) {
+                size_ += approximateSize(header);
+                ir_.headers.push_back(std::move(header));
+            }
+        }
+        spillIfOverBudget();
+    }
+
+    /**
+     * @brief Returns everything collected, in the order it was first seen, and resets the collector.
+     * @throws std::runtime_error if the spill file can not be read back
+     */
+    CollectedIR take() {
+        CollectedIR result;
+        if (spill_) {
+            spill_->close();
+            spill_.reset();
+            readSpillFile(result);
+            removeSpillFile();
+        }
+
+        append(result.structs, std::move(ir_.structs));
+        append(result.functions, std::move(ir_.functions));
+        append(result.headers, std::move(ir_.headers));
+
+        ir_   = {};
+        size_ = 0;
+        seen_.clear();
+        return result;
+    }
+
+    /**
+     * @brief Number of times the IR was spilled to disk.
+     */
+    [[nodiscard]] size_t spillCount() const noexcept { return spills_; }
+
+  private:
+    template <typename T> static void append(std::vector<T> &to, std::vector<T> &&from) {
+        if (to.empty()) {
+            to = std::move(from);
+        } else {
+            to.insert(to.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+        }
+    }
+
+    void spillIfOverBudget() {
+        if (options_.memoryBudget == 0 || size_ <= options_.memoryBudget) {
+            return;
+        }
+
+        if (!spill_) {
+            openSpillFile();
+        }
+
+        // One declaration is converted at a time, spilling never needs a second copy of the batch
+        llvm::json::OStream out(*spill_);
+        out.object([this, &out] {
+            out.attributeArray("structs", [this, &out] {
+                for (const auto &info : ir_.structs) {
+                    out.value(toJSON(info));
+                }
+            });
+            out.attributeArray("functions", [this, &out] {
+                for (const auto &function : ir_.functions) {
+                    out.value(toJSON(function));
+                }
+            });
+            out.attributeArray("headers", [this, &out] {
+                for (const auto &header : ir_.headers) {
+                    out.value(toJSON(header));
+                }
+            });
+        });
+        *spill_ << '\n';
+        spill_->flush();
+        if (spill_->has_error()) {
+            throw std::runtime_error("Failed to write spill file: " + spillPath_);
+        }
+
+        ir_   = {};
+        size_ = 0;
+        ++spills_;
+    }
+
+    void openSpillFile() {
+        int                    fd = -1;
+        llvm::SmallString<256> path;
+        std::error_code        ec;
+        if (options_.spillDirectory.empty()) {
+            ec = llvm::sys::fs::createTemporaryFile("cppglue-ir", "jsonl", fd, path);
+        } else {
+            ec = llvm::sys::fs::createUniqueFile((options_.spillDirectory / "cppglue-ir-%%%%%%.jsonl").string(), fd, path);
+        }
+        if (ec) {
+            throw std::runtime_error("Failed to create spill file: " + ec.message());
+        }
+        spillPath_ = path.str().str();
+        spill_     = std::make_unique<llvm::raw_fd_ostream>(fd, /*shouldClose=*/true);
+    }
+
+    void readSpillFile(CollectedIR &result) {
+        auto buffer = llvm::MemoryBuffer::getFile(spillPath_);
+        if (!buffer) {
+            throw std::runtime_error("Failed to read spill file: " + spillPath_);
+        }
+
+        llvm::StringRef remaining = (*buffer)->getBuffer();
+        while (!remaining.empty()) {
+            auto [line, rest] = remaining.split('\n');
+            remaining         = rest;
+            if (line.empty()) {
+                continue;
+            }
+
+            CollectedIR chunk;
+            auto        value = llvm::json::parse(line);
+            if (!value) {
+                throw std::runtime_error("Corrupt spill file " + spillPath_ + ": " + llvm::toString(value.takeError()));
+            }
+            llvm::json::Path::Root   root;
+            llvm::json::ObjectMapper mapper(*value, root);
+            if (!mapper || !mapper.map("structs", chunk.structs) || !mapper.map("functions", chunk.functions) ||
+                !mapper.map("headers", chunk.headers)) {
+                throw std::runtime_error("Corrupt spill file " + spillPath_ + ": " + llvm::toString(root.getError()));
+            }
+
+            append(result.structs, std::move(chunk.structs));
+            append(result.functions, std::move(chunk.functions));
+            append(result.headers, std::move(chunk.headers));
+        }
+    }
+
+    void removeSpillFile() {
+        spill_.reset();
+        if (!spillPath_.empty()) {
+            llvm::sys::fs::remove(spillPath_);
+            spillPath_.clear();
+        }
+    }
+
+    Options                               options_;
+    CollectedIR                           ir_;
+    size_t                                size_{0};
+    size_t                                spills_{0};
+    llvm::StringSet<>                     seen_;
+    std::unique_ptr<llvm::raw_fd_ostream> spill_;
+    std::string                           spillPath_;
+};
@@ -0,0 +1,243 @@
+#pragma once
+
+#include "ir_json.hpp"
+
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Support/EndianStream.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <memory>
+#include <optional>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class IRFormat { Json, MessagePack };
+
+/**
+ * @brief Which part of the sources an export was extracted from, see ExtractionRequest::shardIndex.
+ */
+struct ShardInfo {
+    size_t index{0};
+    size_t count{1};
+
+    bool operator==(const ShardInfo &) const = default;
+};
+
+/**
+ * @brief Minimal MessagePack encoder for JSON values, integers and lengths use the smallest encoding that fits.
+ * @note Written here instead of using llvm::msgpack to not depend on LLVMBinaryFormat, which is not part of every
+ * LLVM/clang installation py-gen links against.
+ */
+class MessagePackWriter {
+  public:
+    explicit MessagePackWriter(llvm::raw_ostream &out) : out_(out, llvm::endianness::big) {}
+
+    void write(const llvm::json::Value &value) {
+        switch (value.kind()) {
+        case llvm::json::Value::Null:
+            out_.write(uint8_t{0xc0});
+            break;
+        case llvm::json::Value::Boolean:
+            out_.write(static_cast<uint8_t>(*value.getAsBoolean() ? 0xc3 : 0xc2));
+            break;
+        case llvm::json::Value::Number:
+            if (auto integer = value.getAsInteger()) {
+                writeInteger(*integer);
+            } else {
+                out_.write(uint8_t{0xcb});
+                out_.write(*value.getAsNumber());
+            }
+            break;
+        case llvm::json::Value::String:
+            writeString(*value.getAsString());
+            break;
+        case llvm::json::Value::Array: {
+            const auto &array = *value.getAsArray();
+            writeLength(array.size(), 0x90, 0xdc);
+            for (const auto &element : array) {
+                write(element);
+            }
+            break;
+        }
+        case llvm::json::Value::Object: {
+            // Sorted like the JSON output, so the same input always gives the same bytes
+            const auto                                         &object = *value.getAsObject();
+            std::vector<const llvm::json::Object::value_type *> elements;
+            for (const auto &element : object) {
+                elements.push_back(&element);
+            }
+            llvm::sort(elements, [](const auto *lhs, const auto *rhs) { return lhs->first < rhs->first; });
+
+            writeLength(elements.size(), 0x80, 0xde);
+            for (const auto *element : elements) {
+                writeString(element->first);
+                write(element->second);
+            }
+            break;
+        }
+        }
+    }
+
+  private:
+    void writeInteger(int64_t value) {
+        if (value >= 0 && value <= 0x7f) {
+            out_.write(static_cast<uint8_t>(value));
+        } else if (value < 0 && value >= -32) {
+            out_.write(static_cast<int8_t>(value));
+        } else if (value >= INT32_MIN && value <= INT32_MAX) {
+            out_.write(uint8_t{0xd2});
+            out_.write(static_cast<int32_t>(value));
+        } else {
+            out_.write(uint8_t{0xd3});
+            out_.write(value);
+        }
+    }
+
+    void writeString(llvm::StringRef string) {
+        if (string.size() < 32) {
+            out_.write(static_cast<uint8_t>(0xa0 | string.size()));
+        } else if (string.size() <= UINT16_MAX) {
+            out_.write(uint8_t{0xda});
+            out_.write(static_cast<uint16_t>(string.size()));
+        } else {
+            out_.write(uint8_t{0xdb});
+            out_.write(static_cast<uint32_t>(string.size()));
+        }
+        out_.OS << string;
+    }
+
+    /**
+     * @brief Writes an array or map header, fix is the tag of the 4 bit form, tag16 that of the 16 bit form (+1 is 32 bit).
+     */
+    void writeLength(size_t length, uint8_t fix, uint8_t tag16) {
+        if (length < 16) {
+            out_.write(static_cast<uint8_t>(fix | length));
+        } else if (length <= UINT16_MAX) {
+            out_.write(tag16);
+            out_.write(static_cast<uint16_t>(length));
+        } else {
+            out_.write(static_cast<uint8_t>(tag16 + 1));
+            out_.write(static_cast<uint32_t>(length));
+        }
+    }
+
+    llvm::support::endian::Writer out_;
+};
+
+/**
+ * @brief Picks the format from a name ("json", "msgpack") or, if the name is empty, from the file extension.
+ * @return std::nullopt for an unknown format name
+ */
+inline std::optional<IRFormat> irFormatFor(std::string_view name, std::string_view path) {
+    if (name.empty()) {
+        return path.ends_with(".msgpack") || path.ends_with(".mpk") ? IRFormat::MessagePack : IRFormat::Json;
+    }
+    if (name == "json") {
+        return IRFormat::Json;
+    }
+    if (name == "msgpack" || name == "messagepack") {
+        return IRFormat::MessagePack;
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief Streams the extracted declarations to a file while the extraction runs.
+ *
+ * Every callback of the extraction becomes one chunk holding either structs and functions or headers, written
+ * immediately, so nothing is kept in memory after its callback returned.
+ * - JSON: one document, `{"format": "cppglue-ir", "version": 1, "shard": {...}, "chunks": [...]}`, chunks last.
+ * - MessagePack: a stream of maps, first `{"format": "cppglue-ir", "version": 1, "shard": {...}}`, then one map per chunk.
+ * "shard" is only written for a sharded extraction.
+ * The chunk layout is described in schema/cppglue-ir.schema.json.
+ *
+ * @code
+ * IRExporter exporter("ir.json", IRFormat::Json);
+ * session.run(request, [&](Structs &&s, Functions &&f) { exporter.addDeclarations(s, f); },
+ *             [&](Headers &&h) { exporter.addHeaders(h); });
+ * exporter.finish();
+ * @endcode
+ */
+class IRExporter {
+  public:
+    static constexpr int64_t version = 1;
+
+    /**
+     * @throws std::runtime_error if the file can not be opened
+     */
+    IRExporter(const std::string &path, IRFormat format, std::optional<ShardInfo> shard = std::nullopt) {
+        std::error_code ec;
+        file_ = std::make_unique<llvm::raw_fd_ostream>(path, ec, llvm::sys::fs::OF_None);
+        if (ec) {
+            throw std::runtime_error("Failed to open file for writing: " + path + " (" + ec.message() + ")");
+        }
+
+        llvm::json::Object header{{"format", "cppglue-ir"}, {"version", version}};
+        if (shard) {
+            header["shard"] =
+                llvm::json::Object{{"index", static_cast<int64_t>(shard->index)}, {"count", static_cast<int64_t>(shard->count)}};
+        }
+
+        if (format == IRFormat::Json) {
+            // The header goes first, so readers can get it without parsing the chunks
+            json_.emplace(*file_);
+            json_->objectBegin();
+            for (const auto &key : {"format", "version", "shard"}) {
+                if (const auto *value = header.get(key)) {
+                    json_->attribute(key, *value);
+                }
+            }
+            json_->attributeBegin("chunks");
+            json_->arrayBegin();
+        } else {
+            msgpack_.emplace(*file_);
+            msgpack_->write(std::move(header));
+        }
+    }
+
+    ~IRExporter() { finish(); }
+
+    IRExporter(const IRExporter &)            = delete;
+    IRExporter &operator=(const IRExporter &) = delete;
+
+    void addDeclarations(const Structs &structs, const Functions &functions) {
+        writeChunk(llvm::json::Object{{"structs", structs}, {"functions", functions}});
+    }
+
+    void addHeaders(const Headers &headers) { writeChunk(llvm::json::Object{{"headers", headers}}); }
+
+    /**
+     * @brief Closes the document and flushes the file, called by the destructor if not called before.
+     */
+    void finish() {
+        if (!file_) {
+            return;
+        }
+        if (json_) {
+            json_->arrayEnd();
+            json_->attributeEnd();
+            json_->objectEnd();
+            json_->flush();
+        }
+        file_->flush();
+        json_.reset();
+        msgpack_.reset();
+        file_.reset();
+    }
+
+  private:
+    void writeChunk(llvm::json::Value chunk) {
+        if (json_) {
+            json_->value(chunk);
+        } else if (msgpack_) {
+            msgpack_->write(chunk);
+        }
+    }
+
+    std::unique_ptr<llvm::raw_fd_ostream> file_;
+    std::optional<llvm::json::OStream>    json_;
+    std::optional<MessagePackWriter>      msgpack_;
+};
@@ -0,0 +1,273 @@
+#pragma once
+
+#include "ir_export.hpp"
+#include "ir_json.hpp"
+
+#include <cstdint>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/bit.h>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @brief Decodes the MessagePack subset written by MessagePackWriter (and the other scalar encodings) into JSON values.
+ */
+class MessagePackReader {
+  public:
+    explicit MessagePackReader(llvm::StringRef data) : data_(data) {}
+
+    [[nodiscard]] bool atEnd() const noexcept { return position_ >= data_.size(); }
+
+    /**
+     * @throws std::runtime_error on truncated or unsupported input
+     */
+    llvm::json::Value read() {
+        uint8_t tag = take<uint8_t>();
+        if (tag <= 0x7f) {
+            return static_cast<int64_t>(tag);
+        }
+        if (tag >= 0xe0) {
+            return static_cast<int64_t>(static_cast<int8_t>(tag));
+        }
+        if ((tag & 0xf0) == 0x80) {
+            return readMap(tag & 0x0f);
+        }
+        if ((tag & 0xf0) == 0x90) {
+            return readArray(tag & 0x0f);
+        }
+        if ((tag & 0xe0) == 0xa0) {
+            return readString(tag & 0x1f);
+        }
+
+        switch (tag) {
+        case 0xc0:
+            return nullptr;
+        case 0xc2:
+            return false;
+        case 0xc3:
+            return true;
+        case 0xca:
+            return static_cast<double>(llvm::bit_cast<float>(take<uint32_t>()));
+        case 0xcb:
+            return llvm::bit_cast<double>(take<uint64_t>());
+        case 0xcc:
+            return static_cast<int64_t>(take<uint8_t>());
+        case 0xcd:
+            return static_cast<int64_t>(take<uint16_t>());
+        case 0xce:
+            return static_cast<int64_t>(take<uint32_t>());
+        case 0xcf:
+            return take<uint64_t>();
+        case 0xd0:
+            return static_cast<int64_t>(static_cast<int8_t>(take<uint8_t>()));
+        case 0xd1:
+            return static_cast<int64_t>(static_cast<int16_t>(take<uint16_t>()));
+        case 0xd2:
+            return static_cast<int64_t>(static_cast<int32_t>(take<uint32_t>()));
+        case 0xd3:
+            return static_cast<int64_t>(take<uint64_t>());
+        case 0xd9:
+            return readString(take<uint8_t>());
+        case 0xda:
+            return readString(take<uint16_t>());
+        case 0xdb:
+            return readString(take<uint32_t>());
+        case 0xdc:
+            return readArray(take<uint16_t>());
+        case 0xdd:
+            return readArray(take<uint32_t>());
+        case 0xde:
+            return readMap(take<uint16_t>());
+        case 0xdf:
+            return readMap(take<uint32_t>());
+        default:
+            throw std::runtime_error("Unsupported MessagePack type 0x" + llvm::utohexstr(tag));
+        }
+    }
+
+  private:
+    template <typename T> T take() {
+        need(sizeof(T));
+        T value = llvm::support::endian::read<T, llvm::endianness::big>(data_.data() + position_);
+        position_ += sizeof(T);
+        return value;
+    }
+
+    void need(size_t size) const {
+        if (data_.size() - position_ < size) {
+            throw std::runtime_error("Truncated MessagePack data");
+        }
+    }
+
+    llvm::json::Value readString(size_t size) {
+        need(size);
+        auto string = data_.substr(position_, size);
+        position_ += size;
+        return string.str();
+    }
+
+    llvm::json::Value readArray(size_t size) {
+        llvm::json::Array array;
+        array.reserve(size);
+        for (size_t i = 0; i < size; ++i) {
+            array.push_back(read());
+        }
+        return array;
+    }
+
+    llvm::json::Value readMap(size_t size) {
+        llvm::json::Object object;
+        for (size_t i = 0; i < size; ++i) {
+            auto key = read();
+            if (!key.getAsString()) {
+                throw std::runtime_error("MessagePack map keys must be strings");
+            }
+            object[key.getAsString()->str()] = read();
+        }
+        return object;
+    }
+
+    llvm::StringRef data_;
+    size_t          position_{0};
+};
+
+/**
+ * @brief Header of an IR file written by IRExporter.
+ */
+struct IRFileHeader {
+    int64_t                  version{0};
+    std::optional<ShardInfo> shard;
+};
+
+/**
+ * @brief Reads IR files written by IRExporter, in either format (detected from the first byte).
+ *
+ * The file is mapped, not copied, and each chunk is handed to the callbacks as soon as it is decoded, so feeding
+ * an IRCollector keeps only the deduplicated declarations in memory.
+ */
+class IRImporter {
+  public:
+    /**
+     * @brief Reads only the header, for JSON without parsing the chunks following it.
+     * @throws std::runtime_error if the file can not be read or is not an IR file
+     */
+    static IRFileHeader readHeader(const std::string &path) {
+        auto buffer = open(path);
+        auto data   = buffer->getBuffer();
+
+        if (isMessagePack(data)) {
+            MessagePackReader reader(data);
+            return parseHeader(reader.read(), path);
+        }
+
+        // IRExporter writes the chunks last, everything before them is the header
+        auto chunks = data.find("\"chunks\"");
+        if (chunks != llvm::StringRef::npos) {
+            auto prefix = data.substr(0, chunks).rtrim();
+            if (prefix.consume_back(",")) {
+                if (auto header = llvm::json::parse(prefix.str() + "}")) {
+                    return parseHeader(*header, path);
+                } else {
+                    llvm::consumeError(header.takeError());
+                }
+            }
+        }
+        return parseHeader(parseJson(data, path), path);
+    }
+
+    /**
+     * @brief Reads a whole file, calling cb for every declaration chunk and hcb for every header chunk.
+     * @throws std::runtime_error if the file can not be read or is not a valid IR file
+     */
+    static IRFileHeader read(const std::string &path, const VisitCompleteCallback &cb, const HeaderCallback &hcb) {
+        auto buffer = open(path);
+        auto data   = buffer->getBuffer();
+
+        if (isMessagePack(data)) {
+            MessagePackReader reader(data);
+            auto              header = parseHeader(reader.read(), path);
+            while (!reader.atEnd()) {
+                dispatchChunk(reader.read(), cb, hcb, path);
+            }
+            return header;
+        }
+
+        auto document = parseJson(data, path);
+        auto header   = parseHeader(document, path);
+        if (const auto *chunks = document.getAsObject()->getArray("chunks")) {
+            for (const auto &chunk : *chunks) {
+                dispatchChunk(chunk, cb, hcb, path);
+            }
+        }
+        return header;
+    }
+
+  private:
+    static std::unique_ptr<llvm::MemoryBuffer> open(const std::string &path) {
+        auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+        if (!buffer) {
+            throw std::runtime_error("Failed to read " + path + ": " + buffer.getError().message());
+        }
+        return std::move(*buffer);
+    }
+
+    static bool isMessagePack(llvm::StringRef data) {
+        // A JSON document starts with '{' or whitespace, a MessagePack header with a map tag
+        return !data.empty() && (static_cast<uint8_t>(data[0]) & 0xf0) == 0x80;
+    }
+
+    static llvm::json::Value parseJson(llvm::StringRef data, const std::string &path) {
+        auto value = llvm::json::parse(data);
+        if (!value) {
+            throw std::runtime_error("Invalid JSON in " + path + ": " + llvm::toString(value.takeError()));
+        }
+        return std::move(*value);
+    }
+
+    static IRFileHeader parseHeader(const llvm::json::Value &value, const std::string &path) {
+        const auto *object = value.getAsObject();
+        if (object == nullptr || object->getString("format") != "cppglue-ir") {
+            throw std::runtime_error(path + " is not a cppglue IR file");
+        }
+
+        IRFileHeader header;
+        header.version = object->getInteger("version").value_or(0);
+        if (header.version != IRExporter::version) {
+            throw std::runtime_error(path + " has IR version " + std::to_string(header.version) + ", expected " +
+                                     std::to_string(IRExporter::version));
+        }
+
+        if (const auto *shard = object->getObject("shard")) {
+            auto index = shard->getInteger("index");
+            auto count = shard->getInteger("count");
+            if (!index || !count || *index < 0 || *count <= *index) {
+                throw std::runtime_error(path + " has an invalid shard");
+            }
+            header.shard = ShardInfo{.index = static_cast<size_t>(*index), .count = static_cast<size_t>(*count)};
+        }
+        return header;
+    }
+
+    static void dispatchChunk(const llvm::json::Value &chunk, const VisitCompleteCallback &cb, const HeaderCallback &hcb,
+                              const std::string &path) {
+        llvm::json::Path::Root   root("chunk");
+        llvm::json::ObjectMapper mapper(chunk, root);
+        Structs                  structs;
+        Functions                functions;
+        Headers                  headers;
+        if (!mapper || !mapper.mapOptional("structs", structs) || !mapper.mapOptional("functions", functions) ||
+            !mapper.mapOptional("headers", headers)) {
+            throw std::runtime_error("Invalid chunk in " + path + ": " + llvm::toString(root.getError()));
+        }
+
+        if (!structs.empty() || !functions.empty()) {
+            cb(std::move(structs), std::move(functions));
+        }
+        if (!headers.empty()) {
+            hcb(std::move(headers));
+        }
+    }
+};
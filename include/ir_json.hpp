@@ -0,0 +1,187 @@
+#pragma once
+
+#include "include_tracker.hpp"
+#include "visitor.hpp"
+
+#include <algorithm>
+#include <array>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/JSON.h>
+
+/**
+ * JSON mapping of the extracted declarations, see schema/cppglue-ir.schema.json.
+ *
+ * Keys are the C++ member names, optional members are written as null. The toJSON overloads let any IR value be
+ * used where an llvm::json::Value is expected, the fromJSON overloads read it back with llvm::json::ObjectMapper.
+ */
+
+inline llvm::json::Value toJSON(const DeclarationName &name) {
+    return llvm::json::Object{{"plain", name.plain}, {"qualified", name.qualified}, {"namespace", name.namespace_}};
+}
+
+/**
+ * @brief Names of TypeInfo::Kind, in enumerator order.
+ */
+inline constexpr std::array<llvm::StringLiteral, 12> typeKindNames = {
+    "void", "bool", "integer", "floating", "enum", "record", "pointer", "lvalueReference", "rvalueReference", "array", "function", "other"};
+
+/**
+ * @brief An interned type, read back into TypeTable::shared() by fromJSON.
+ *
+ * Written in full, with the types it is built from nested, wherever it is used: any chunk, spill line or export can
+ * be read on its own, whatever the table of the writing process looked like.
+ */
+struct InternedType {
+    TypeIndex index{noType};
+};
+
+inline llvm::json::Value toJSON(const InternedType &type) {
+    if (type.index == noType) {
+        return nullptr;
+    }
+    const auto       &info = TypeTable::shared()[type.index];
+    llvm::json::Array arguments;
+    for (auto argument : info.arguments) {
+        arguments.push_back(toJSON(InternedType{argument}));
+    }
+    return llvm::json::Object{{"kind", typeKindNames[static_cast<size_t>(info.kind)]},
+                              {"spelling", info.spelling},
+                              {"name", info.name},
+                              {"arguments", std::move(arguments)},
+                              {"element", toJSON(InternedType{info.element})},
+                              {"isConst", info.isConst},
+                              {"isVolatile", info.isVolatile}};
+}
+
+inline bool fromJSON(const llvm::json::Value &value, InternedType &type, llvm::json::Path path) {
+    if (value.getAsNull()) {
+        type.index = noType;
+        return true;
+    }
+
+    TypeInfo                  info;
+    std::string               kind;
+    std::vector<InternedType> arguments;
+    InternedType              element;
+    llvm::json::ObjectMapper  mapper(value, path);
+    if (!mapper || !mapper.map("kind", kind) || !mapper.map("spelling", info.spelling) || !mapper.map("name", info.name) ||
+        !mapper.map("arguments", arguments) || !mapper.map("element", element) || !mapper.map("isConst", info.isConst) ||
+        !mapper.map("isVolatile", info.isVolatile)) {
+        return false;
+    }
+    auto known = std::find(typeKindNames.begin(), typeKindNames.end(), kind);
+    if (known == typeKindNames.end()) {
+        path.field("kind").report("unknown type kind");
+        return false;
+    }
+
+    info.kind    = static_cast<TypeInfo::Kind>(known - typeKindNames.begin());
+    info.element = element.index;
+    for (const auto &argument : arguments) {
+        info.arguments.push_back(argument.index);
+    }
+    type.index = TypeTable::shared().intern(std::move(info));
+    return true;
+}
+
+inline llvm::json::Value toJSON(const FunctionInfo &function);
+
+inline llvm::json::Value toJSON(const FieldDeclarationInfo &field) {
+    llvm::json::Array functionals;
+    for (const auto &functional : field.functionals) {
+        functionals.push_back(toJSON(functional));
+    }
+
+    return llvm::json::Object{{"type", toJSON(field.type)},
+                              {"name", toJSON(field.name)},
+                              {"value", field.value},
+                              {"isConst", field.isConst},
+                              {"isPointer", field.isPointer},
+                              {"isReference", field.isReference},
+                              {"isFunctional", field.isFunctional},
+                              {"isPublic", field.isPublic},
+                              {"functionals", std::move(functionals)},
+                              {"typeInfo", toJSON(InternedType{field.typeIndex})}};
+}
+
+inline llvm::json::Value toJSON(const StructInfo &info) {
+    return llvm::json::Object{{"name", toJSON(info.name)},
+                              {"isEnum", info.isEnum},
+                              {"members", info.members},
+                              {"definingFile", info.definingFile},
+                              {"constructors", info.constructors},
+                              {"isAggregate", info.isAggregate},
+                              {"isDefaultConstructible", info.isDefaultConstructible},
+                              {"hasAllFields", info.hasAllFields}};
+}
+
+inline llvm::json::Value toJSON(const FunctionInfo &function) {
+    return llvm::json::Object{{"name", toJSON(function.name)},
+                              {"returnType", toJSON(function.returnType)},
+                              {"returnTypeInfo", toJSON(InternedType{function.returnTypeIndex})},
+                              {"namespace", function.namespace_},
+                              {"isMemberFunction", function.isMemberFunction},
+                              {"isPureVirtual", function.isPureVirtual},
+                              {"isStatic", function.isStatic},
+                              {"isConst", function.isConst},
+                              {"parent", function.parent ? toJSON(*function.parent) : llvm::json::Value(nullptr)},
+                              {"parameters", function.parameters},
+                              {"definingFile", function.definingFile}};
+}
+
+inline llvm::json::Value toJSON(const Header &header) {
+    return llvm::json::Object{{"name", header.name},
+                              {"fullPath", header.fullPath},
+                              {"isSystem", header.isSystem},
+                              {"isInputFile", header.isInputFile},
+                              {"isDirect", header.isDirect}};
+}
+
+inline bool fromJSON(const llvm::json::Value &value, DeclarationName &name, llvm::json::Path path) {
+    llvm::json::ObjectMapper mapper(value, path);
+    return mapper && mapper.map("plain", name.plain) && mapper.map("qualified", name.qualified) &&
+           mapper.mapOptional("namespace", name.namespace_);
+}
+
+inline bool fromJSON(const llvm::json::Value &value, FunctionInfo &function, llvm::json::Path path);
+
+inline bool fromJSON(const llvm::json::Value &value, FieldDeclarationInfo &field, llvm::json::Path path) {
+    llvm::json::ObjectMapper mapper(value, path);
+    InternedType             type;
+    bool mapped = mapper && mapper.map("type", field.type) && mapper.map("name", field.name) && mapper.map("value", field.value) &&
+                  mapper.map("isConst", field.isConst) && mapper.map("isPointer", field.isPointer) &&
+                  mapper.map("isReference", field.isReference) && mapper.map("isFunctional", field.isFunctional) &&
+                  mapper.map("isPublic", field.isPublic) && mapper.mapOptional("functionals", field.functionals) &&
+                  mapper.mapOptional("typeInfo", type);
+    field.typeIndex = type.index;
+    return mapped;
+}
+
+inline bool fromJSON(const llvm::json::Value &value, StructInfo &info, llvm::json::Path path) {
+    llvm::json::ObjectMapper mapper(value, path);
+    return mapper && mapper.map("name", info.name) && mapper.map("isEnum", info.isEnum) && mapper.map("members", info.members) &&
+           mapper.mapOptional("definingFile", info.definingFile) && mapper.mapOptional("constructors", info.constructors) &&
+           mapper.mapOptional("isAggregate", info.isAggregate) &&
+           mapper.mapOptional("isDefaultConstructible", info.isDefaultConstructible) &&
+           mapper.mapOptional("hasAllFields", info.hasAllFields);
+}
+
+inline bool fromJSON(const llvm::json::Value &value, FunctionInfo &function, llvm::json::Path path) {
+    llvm::json::ObjectMapper mapper(value, path);
+    InternedType             returnType;
+    bool mapped = mapper && mapper.map("name", function.name) && mapper.map("returnType", function.returnType) &&
+                  mapper.mapOptional("returnTypeInfo", returnType) && mapper.mapOptional("namespace", function.namespace_) &&
+                  mapper.map("isMemberFunction", function.isMemberFunction) && mapper.map("isPureVirtual", function.isPureVirtual) &&
+                  mapper.map("isStatic", function.isStatic) && mapper.mapOptional("isConst", function.isConst) &&
+                  mapper.mapOptional("parent", function.parent) && mapper.map("parameters", function.parameters) &&
+                  mapper.mapOptional("definingFile", function.definingFile);
+    function.returnTypeIndex = returnType.index;
+    return mapped;
+}
+
+inline bool fromJSON(const llvm::json::Value &value, Header &header, llvm::json::Path path) {
+    llvm::json::ObjectMapper mapper(value, path);
+    return mapper && mapper.map("name", header.name) && mapper.map("fullPath", header.fullPath) &&
+           mapper.map("isSystem", header.isSystem) && mapper.map("isInputFile", header.isInputFile) &&
+           mapper.mapOptional("isDirect", header.isDirect);
+}
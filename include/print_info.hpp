@@ -6,6 +6,9 @@
 inline void printInfo(const Structs &structs, const Functions &functions, const Headers &headers) {
 
     for (const auto &header : headers) {
+        if (!header.isDirect) {
+            continue;
+        }
         llvm::outs() << "Header: " << header.name << " system: <" << (header.isSystem ? "yes" : "no") << "> (" << header.fullPath << ")\n";
     }
 
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Index of a type in the TypeTable.
+ */
+using TypeIndex = std::uint32_t;
+
+/**
+ * @brief No type recorded, e.g. IR imported from an export written before types were interned.
+ */
+inline constexpr TypeIndex noType = std::numeric_limits<TypeIndex>::max();
+
+/**
+ * @brief The structure of a canonical type, so code generators look at kinds and arguments instead of parsing spellings.
+ */
+struct TypeInfo {
+    enum class Kind : std::uint8_t {
+        Void,
+        Bool,
+        Integer, // Including characters
+        Floating,
+        Enum,
+        Record,
+        Pointer,
+        LValueReference,
+        RValueReference,
+        Array,
+        Function,
+        Other
+    };
+
+    Kind                   kind{Kind::Other};
+    std::string            spelling;         // Canonical C++ spelling without tag keywords, e.g. "const std::vector<int> &"
+    std::string            name;             // Records and enums: the qualified name without template arguments ("std::vector")
+    std::vector<TypeIndex> arguments;        // Class template specializations: the type arguments, functions: the parameters
+    TypeIndex              element{noType};  // Pointers and references: the type referred to, arrays: the element, functions: the result
+    bool                   isConst{false};
+    bool                   isVolatile{false};
+
+    bool operator==(const TypeInfo &) const = default;
+};
+
+/**
+ * @brief Interns the distinct types seen in this process, keyed by their canonical spelling.
+ *
+ * The Visitor adds each distinct type of a translation unit once, fields, parameters and results refer to it by index.
+ * Indices stay valid for the lifetime of the process (entries are never removed and never move), so IR from any
+ * translation unit, spill file or import can be compared and looked up without a table of its own. The table only
+ * grows with the number of distinct types, not with the number of declarations using them.
+ */
+class TypeTable {
+  public:
+    /**
+     * @brief The table of this process.
+     */
+    static TypeTable &shared() {
+        static auto *table = new TypeTable(); // Never destroyed, IR may outlive static destruction order
+        return *table;
+    }
+
+    /**
+     * @brief Index of the type with the spelling of info, which is added unless a type of that spelling already is.
+     */
+    TypeIndex intern(TypeInfo info) {
+        std::lock_guard lock(mutex_);
+        auto [it, inserted] = indices_.try_emplace(info.spelling, static_cast<TypeIndex>(types_.size()));
+        if (inserted) {
+            types_.push_back(std::move(info));
+        }
+        return it->second;
+    }
+
+    [[nodiscard]] std::optional<TypeIndex> find(const std::string &spelling) const {
+        std::lock_guard lock(mutex_);
+        auto            it = indices_.find(spelling);
+        return it == indices_.end() ? std::nullopt : std::optional<TypeIndex>(it->second);
+    }
+
+    /**
+     * @brief The type at index, the reference stays valid while more types are interned.
+     */
+    [[nodiscard]] const TypeInfo &operator[](TypeIndex index) const {
+        std::lock_guard lock(mutex_);
+        return types_[index];
+    }
+
+    [[nodiscard]] size_t size() const {
+        std::lock_guard lock(mutex_);
+        return types_.size();
+    }
+
+  private:
+    mutable std::mutex                         mutex_;
+    std::deque<TypeInfo>                       types_; // A deque, references survive appends
+    std::unordered_map<std::string, TypeIndex> indices_;
+};
@@ -1,15 +1,24 @@
 #pragma once
 
+#include "declaration_filter.hpp"
+#include "type_table.hpp"
+
+#include <algorithm>
+#include <cctype>
 #include <clang/AST/ASTContext.h>
 #include <clang/AST/Decl.h>
+#include <clang/AST/DeclTemplate.h>
 #include <clang/AST/ExprCXX.h>
+#include <clang/AST/QualTypeNames.h>
 #include <clang/AST/RecursiveASTVisitor.h>
 #include <clang/Basic/SourceManager.h>
 #include <fmt/format.h>
+#include <iterator>
 #include <llvm/Support/raw_ostream.h>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <utility>
 
 struct DeclarationName {
@@ -18,6 +27,8 @@ struct DeclarationName {
     std::optional<std::string> namespace_;
 
     [[nodiscard]] bool hasNamespace() const noexcept { return namespace_.has_value(); }
+
+    bool operator==(const DeclarationName &) const = default;
 };
 
 struct StructInfo;
@@ -37,34 +48,97 @@ struct FieldDeclarationInfo {
 
     std::vector<FunctionInfo> functionals;
 
+    TypeIndex typeIndex{noType}; // The type in TypeTable::shared()
+
     [[nodiscard]] constexpr bool isSpecial() const noexcept { return isConst || isPointer || isReference || isFunctional || spare1; }
+
+    bool operator==(const FieldDeclarationInfo &) const = default;
 };
 
 struct StructInfo {
     DeclarationName                   name;
     bool                              isEnum{false};
     std::vector<FieldDeclarationInfo> members;
+    std::string                       definingFile; // Real path of the file containing the declaration
+
+    // Public, not deleted constructors except copy and move constructors
+    std::vector<FunctionInfo> constructors;
+    bool                      isAggregate{false};           // All members, in order, can be initialized with braces
+    bool                      isDefaultConstructible{true}; // Default for IR without the information, bound with py::init<>()
+    bool                      hasAllFields{true};           // members are all data members, none inherited or filtered out
 
     [[nodiscard]] bool   empty() const noexcept { return members.empty(); }
     [[nodiscard]] size_t memberCount() const noexcept { return members.size(); }
+
+    bool operator==(const StructInfo &) const = default;
 };
 
 struct FunctionInfo {
     DeclarationName                   name;
     DeclarationName                   returnType;
+    TypeIndex                         returnTypeIndex{noType}; // The result type in TypeTable::shared()
     std::optional<std::string>        namespace_;
     bool                              isMemberFunction{false};
     bool                              isPureVirtual{false};
     bool                              isStatic{false};
+    bool                              isConst{false}; // const qualified member function
     std::optional<DeclarationName>    parent;
+    // Types (type.qualified) spelled fully qualified, as written with typedefs, so the generated code can name them
     std::vector<FieldDeclarationInfo> parameters;
+    std::string                       definingFile; // Real path of the file containing the declaration
 
     [[nodiscard]] bool hasParameters() const noexcept { return !parameters.empty(); }
+
+    bool operator==(const FunctionInfo &) const = default;
 };
 
 using Structs   = std::vector<StructInfo>;
 using Functions = std::vector<FunctionInfo>;
 
+/**
+ * @brief Namespace of the aliases naming the class template instantiations to extract, see ExtractionRequest::instantiations.
+ *
+ * `using MatrixF = Matrix<float>;` in this namespace yields a struct named MatrixF in Python, bound to the C++ type
+ * Matrix<float>, with the fields and member functions of that specialization.
+ */
+inline constexpr std::string_view instantiationNamespace = "cppglue_instantiations";
+
+/**
+ * @brief A class template instantiation to extract, e.g. {.type = "alpha::Matrix<float>", .name = "MatrixF"}.
+ */
+struct Instantiation {
+    std::string type;   // C++ type, qualified as seen from the global namespace
+    std::string name;   // Python name, derived from the type (Matrix_float) if empty
+    std::string header; // Header declaring the template, all header sources are included if empty
+
+    /**
+     * @brief The Python name: the given one, or the type without scope with every other character run turned into '_'.
+     */
+    [[nodiscard]] std::string pythonName() const {
+        if (!name.empty()) {
+            return name;
+        }
+        std::string_view spelling = type;
+        auto             scope    = spelling.substr(0, spelling.find('<')).rfind("::");
+        if (scope != std::string_view::npos) {
+            spelling.remove_prefix(scope + 2);
+        }
+
+        std::string result;
+        for (char c : spelling) {
+            if (std::isalnum(static_cast<unsigned char>(c)) != 0) {
+                result += c;
+            } else if (!result.empty() && result.back() != '_') {
+                result += '_';
+            }
+        }
+        while (!result.empty() && result.back() == '_') {
+            result.pop_back();
+        }
+        return result;
+    }
+};
+
 /**
  * @brief Callback type for when the visit is complete.
  * The reason for this layer is incase of multiple visits, we can aggregate the results and apply mutexes if needed.
@@ -84,19 +158,10 @@ template <typename T> static DeclarationName createDeclarationName(const T *decl
                            .namespace_ = getNamespaceFromContext(declaration->getDeclContext())};
 }
 
-static FieldDeclarationInfo createFieldInfo(const clang::QualType &type, const std::string &name, const std::string &qualifiedName) {
-    return FieldDeclarationInfo{
-        .type        = {.plain = type.getAsString(), .qualified = type.getCanonicalType().getAsString(), .namespace_ = std::nullopt},
-        .name        = {.plain = name, .qualified = qualifiedName, .namespace_ = std::nullopt},
-        .isConst     = type.isConstQualified(),
-        .isPointer   = type->isPointerType(),
-        .isReference = type->isReferenceType(),
-        .functionals = {}};
-}
-
 class Visitor : public clang::RecursiveASTVisitor<Visitor> {
   public:
-    explicit Visitor(clang::ASTContext *context, VisitCompleteCallback cb) : context_(context), cb_(std::move(cb)) {}
+    explicit Visitor(clang::ASTContext *context, VisitCompleteCallback cb, const DeclarationFilter *filter = nullptr)
+        : context_(context), cb_(std::move(cb)), filter_(filter), policy_(context->getLangOpts()) {}
 
     /**
      * @brief Filters the qualified name of a given declaration.
@@ -129,21 +194,116 @@ class Visitor : public clang::RecursiveASTVisitor<Visitor> {
         return llvm::raw_string_ostream{stringBuffer_};
     }
 
+    /**
+     * @brief Applies the configured DeclarationFilter (if any) to a declaration that passed FilterQualifiedName.
+     */
+    bool isFilteredOut(std::string_view qName, const std::string &definingFile, clang::AccessSpecifier access) const {
+        return filter_ != nullptr && (!filter_->acceptsAccess(access) || !filter_->accepts(qName, definingFile));
+    }
+
+    /**
+     * @brief Skips whole namespaces that are in system headers or excluded by the filter, nothing inside would be extracted.
+     * The instantiation namespace is always traversed, its aliases were requested explicitly.
+     */
+    bool TraverseNamespaceDecl(clang::NamespaceDecl *declaration) {
+        if (context_->getSourceManager().isInSystemHeader(declaration->getLocation()) ||
+            (filter_ != nullptr && declaration->getName() != instantiationNamespace &&
+             filter_->prunesScope(declaration->getQualifiedNameAsString()))) {
+            return true;
+        }
+        return clang::RecursiveASTVisitor<Visitor>::TraverseNamespaceDecl(declaration);
+    }
+
+    /**
+     * @brief Skips records (with their nested types and methods) that the filter excludes as a whole.
+     */
+    bool TraverseCXXRecordDecl(clang::CXXRecordDecl *declaration) {
+        if (filter_ != nullptr &&
+            (!filter_->acceptsAccess(declaration->getAccess()) || filter_->prunesScope(declaration->getQualifiedNameAsString()))) {
+            return true;
+        }
+        return clang::RecursiveASTVisitor<Visitor>::TraverseCXXRecordDecl(declaration);
+    }
+
+    /**
+     * @brief Returns the real path of the file a declaration is written in, macro expansions resolve to the expansion site.
+     */
+    std::string getDefiningFile(const clang::Decl *declaration) const {
+        const auto &sourceManager = context_->getSourceManager();
+        auto        fileId        = sourceManager.getFileID(sourceManager.getExpansionLoc(declaration->getLocation()));
+        if (auto entry = sourceManager.getFileEntryRefForID(fileId)) {
+            auto realPath = entry->getFileEntry().tryGetRealPathName();
+            return realPath.empty() ? entry->getName().str() : realPath.str();
+        }
+        return {};
+    }
+
     bool VisitCXXRecordDecl(clang::CXXRecordDecl *declaration) {
+        // Templates and their specializations have no bindable type of their own, instantiations are requested by alias
+        if (declaration->isDependentContext() || llvm::isa<clang::ClassTemplateSpecializationDecl>(declaration)) {
+            return true;
+        }
+
         auto [isNonUserCode, qName] = FilterQualifiedName(declaration);
         if (isNonUserCode) {
             return true;
         }
 
+        auto definingFile = getDefiningFile(declaration);
+        if (isFilteredOut(qName, definingFile, declaration->getAccess())) {
+            return true;
+        }
+
         StructInfo info;
-        info.name = createDeclarationName(declaration);
+        info.name         = createDeclarationName(declaration);
+        info.definingFile = std::move(definingFile);
+        addFields(declaration, info);
+        addConstructors(declaration, info);
+        structs_.push_back(info);
+        return true;
+    }
 
-        for (const auto *field : declaration->fields()) {
-            auto fieldInfo     = createFieldInfo(field->getType(), field->getName().str(), field->getQualifiedNameAsString());
-            fieldInfo.isPublic = field->getAccess() == clang::AccessSpecifier::AS_public;
-            info.members.emplace_back(fieldInfo);
+    /**
+     * @brief Extracts the class template instantiation named by an alias in the instantiation namespace.
+     *
+     * The alias was written by ExtractionSession and its type completed there, so the specialization's fields and
+     * member function declarations are instantiated. The filter does not apply, the instantiation was asked for.
+     */
+    bool VisitTypeAliasDecl(clang::TypeAliasDecl *declaration) {
+        const auto *scope = llvm::dyn_cast<clang::NamespaceDecl>(declaration->getDeclContext());
+        if (scope == nullptr || scope->getName() != instantiationNamespace) {
+            return true;
+        }
+
+        auto        type           = declaration->getUnderlyingType().getCanonicalType();
+        const auto *specialization = llvm::dyn_cast_or_null<clang::ClassTemplateSpecializationDecl>(type->getAsCXXRecordDecl());
+        if (specialization == nullptr || !specialization->hasDefinition()) {
+            llvm::errs() << "Skipping " << declaration->getName() << ": not a complete class template instantiation\n";
+            return true;
+        }
+
+        // The Python name is the alias, the C++ name the fully qualified specialization, e.g. alpha::Matrix<float>
+        DeclarationName name{
+            .plain      = declaration->getName().str(),
+            .qualified  = spell(type).fullyQualified,
+            .namespace_ = getNamespaceFromContext(specialization->getDeclContext())};
+
+        StructInfo info;
+        info.name         = name;
+        info.definingFile = getDefiningFile(specialization);
+        addFields(specialization, info);
+        addConstructors(specialization, info);
+        structs_.push_back(std::move(info));
+
+        for (const auto *method : specialization->methods()) {
+            if (method->isImplicit() || llvm::isa<clang::CXXConstructorDecl, clang::CXXDestructorDecl, clang::CXXConversionDecl>(method) ||
+                method->isOverloadedOperator() || (filter_ != nullptr && !filter_->acceptsAccess(method->getAccess()))) {
+                continue;
+            }
+            auto function   = extractFunction(method, getDefiningFile(specialization));
+            function.parent = name;
+            functions_.push_back(std::move(function));
         }
-        structs_.push_back(info);
         return true;
     }
 
@@ -162,15 +322,23 @@ class Visitor : public clang::RecursiveASTVisitor<Visitor> {
             return true;
         }
 
+        auto definingFile = getDefiningFile(declaration);
+        if (isFilteredOut(qName, definingFile, declaration->getAccess())) {
+            return true;
+        }
+
         StructInfo info;
         info.isEnum         = true;
         info.name.plain     = declaration->getName();
         info.name.qualified = declaration->getQualifiedNameAsString();
+        info.definingFile   = std::move(definingFile);
 
+        const auto &integerType = spell(declaration->getIntegerType());
         for (const auto *enumerator : declaration->enumerators()) {
             FieldDeclarationInfo fieldInfo;
-            fieldInfo.type.plain     = declaration->getIntegerType().getAsString();
-            fieldInfo.type.qualified = declaration->getIntegerType().getCanonicalType().getAsString();
+            fieldInfo.type.plain     = integerType.plain;
+            fieldInfo.type.qualified = integerType.canonical;
+            fieldInfo.typeIndex      = integerType.index;
             fieldInfo.name.plain     = enumerator->getName();
             fieldInfo.name.qualified = enumerator->getQualifiedNameAsString();
             fieldInfo.value          = enumerator->getInitVal().getExtValue();
@@ -183,21 +351,238 @@ class Visitor : public clang::RecursiveASTVisitor<Visitor> {
     }
 
     bool VisitFunctionDecl(clang::FunctionDecl *declaration) {
+        // Function templates and members of class templates can not be bound without arguments, see VisitTypeAliasDecl.
+        // Constructors are extracted with their class, see addConstructors
+        if (declaration->isDependentContext() || llvm::isa<clang::ClassTemplateSpecializationDecl>(declaration->getDeclContext()) ||
+            llvm::isa<clang::CXXConstructorDecl, clang::CXXDestructorDecl>(declaration)) {
+            return true;
+        }
+
         auto [isNonUserCode, qName] = FilterQualifiedName(declaration);
         if (isNonUserCode) {
             return true;
         }
 
+        auto definingFile = getDefiningFile(declaration);
+        if (isFilteredOut(qName, definingFile, declaration->getAccess())) {
+            return true;
+        }
+
+        functions_.push_back(extractFunction(declaration, std::move(definingFile)));
+        return true;
+    }
+
+    ~Visitor() { cb_(std::move(structs_), std::move(functions_)); }
+
+  private:
+    /**
+     * @brief A type as spelled in the IR, printed once per distinct (sugared) type of the translation unit.
+     */
+    struct TypeSpelling {
+        std::string plain;          // As written
+        std::string canonical;      // Canonical, as QualType::getAsString prints it (with tag keywords)
+        std::string fullyQualified; // As written with every scope, so generated code can name it
+        TypeIndex   index{noType};  // In TypeTable::shared()
+    };
+
+    const TypeSpelling &spell(clang::QualType type) const {
+        auto [it, inserted] = spellings_.try_emplace(type.getAsOpaquePtr());
+        if (inserted) {
+            it->second = {.plain          = type.getAsString(),
+                          .canonical      = type.getCanonicalType().getAsString(),
+                          .fullyQualified = clang::TypeName::getFullyQualifiedName(type, *context_, policy_),
+                          .index          = internType(type)};
+        }
+        return it->second;
+    }
+
+    /**
+     * @brief Interns the canonical type (and the types it is built from), each distinct type is described only once.
+     */
+    TypeIndex internType(clang::QualType type) const {
+        auto canonical = type.getCanonicalType();
+        if (auto it = typeIndices_.find(canonical.getAsOpaquePtr()); it != typeIndices_.end()) {
+            return it->second;
+        }
+
+        TypeInfo info;
+        info.spelling   = canonical.getAsString(policy_);
+        info.isConst    = canonical.isConstQualified();
+        info.isVolatile = canonical.isVolatileQualified();
+
+        const auto *typePtr = canonical.getTypePtr();
+        if (typePtr->isVoidType()) {
+            info.kind = TypeInfo::Kind::Void;
+        } else if (typePtr->isBooleanType()) {
+            info.kind = TypeInfo::Kind::Bool;
+        } else if (const auto *enumType = typePtr->getAs<clang::EnumType>()) {
+            info.kind = TypeInfo::Kind::Enum;
+            info.name = enumType->getDecl()->getQualifiedNameAsString();
+        } else if (typePtr->isIntegerType()) {
+            info.kind = TypeInfo::Kind::Integer;
+        } else if (typePtr->isRealFloatingType()) {
+            info.kind = TypeInfo::Kind::Floating;
+        } else if (const auto *reference = typePtr->getAs<clang::ReferenceType>()) {
+            info.kind    = llvm::isa<clang::LValueReferenceType>(reference) ? TypeInfo::Kind::LValueReference
+                                                                                : TypeInfo::Kind::RValueReference;
+            info.element = internType(reference->getPointeeType());
+        } else if (typePtr->isPointerType()) {
+            info.kind    = TypeInfo::Kind::Pointer;
+            info.element = internType(typePtr->getPointeeType());
+        } else if (const auto *array = typePtr->getAsArrayTypeUnsafe()) {
+            info.kind    = TypeInfo::Kind::Array;
+            info.element = internType(array->getElementType());
+        } else if (const auto *function = typePtr->getAs<clang::FunctionProtoType>()) {
+            info.kind    = TypeInfo::Kind::Function;
+            info.element = internType(function->getReturnType());
+            for (auto parameter : function->getParamTypes()) {
+                info.arguments.push_back(internType(parameter));
+            }
+        } else if (const auto *record = typePtr->getAsCXXRecordDecl()) {
+            info.kind = TypeInfo::Kind::Record;
+            info.name = record->getQualifiedNameAsString();
+            if (const auto *specialization = llvm::dyn_cast<clang::ClassTemplateSpecializationDecl>(record)) {
+                info.name = specialization->getSpecializedTemplate()->getQualifiedNameAsString();
+                for (const auto &argument : specialization->getTemplateArgs().asArray()) {
+                    // Packs (std::tuple<int, double>) count as their elements, non-type arguments only show in the spelling
+                    auto arguments = argument.getKind() == clang::TemplateArgument::Pack
+                                         ? argument.pack_elements()
+                                         : llvm::ArrayRef<clang::TemplateArgument>(argument);
+                    for (const auto &element : arguments) {
+                        if (element.getKind() == clang::TemplateArgument::Type) {
+                            info.arguments.push_back(internType(element.getAsType()));
+                        }
+                    }
+                }
+            }
+        }
+
+        auto index = TypeTable::shared().intern(std::move(info));
+        typeIndices_.try_emplace(canonical.getAsOpaquePtr(), index);
+        return index;
+    }
+
+    /**
+     * @brief The signature of a std::function (or a reference to one) as a function without name, std::nullopt for
+     * other types.
+     */
+    static std::optional<FunctionInfo> functionalSignature(TypeIndex index) {
+        const auto &table = TypeTable::shared();
+        const auto *type  = &table[index];
+        if (type->kind == TypeInfo::Kind::LValueReference || type->kind == TypeInfo::Kind::RValueReference) {
+            type = &table[type->element];
+        }
+        if (type->kind != TypeInfo::Kind::Record || type->name != "std::function" || type->arguments.empty() ||
+            table[type->arguments.front()].kind != TypeInfo::Kind::Function) {
+            return std::nullopt;
+        }
+
+        const auto  &signature = table[type->arguments.front()];
+        FunctionInfo functional;
+        functional.returnType      = {.plain = table[signature.element].spelling, .qualified = table[signature.element].spelling};
+        functional.returnTypeIndex = signature.element;
+        for (auto argument : signature.arguments) {
+            const auto          &argumentType = table[argument];
+            FieldDeclarationInfo parameter;
+            parameter.type        = {.plain = argumentType.spelling, .qualified = argumentType.spelling};
+            parameter.typeIndex   = argument;
+            parameter.isConst     = argumentType.isConst;
+            parameter.isPointer   = argumentType.kind == TypeInfo::Kind::Pointer;
+            parameter.isReference =
+                argumentType.kind == TypeInfo::Kind::LValueReference || argumentType.kind == TypeInfo::Kind::RValueReference;
+            functional.parameters.push_back(std::move(parameter));
+        }
+        return functional;
+    }
+
+    FieldDeclarationInfo createFieldInfo(const clang::QualType &type, const std::string &name, const std::string &qualifiedName) const {
+        const auto &spelling = spell(type);
+        return FieldDeclarationInfo{.type        = {.plain = spelling.plain, .qualified = spelling.canonical, .namespace_ = std::nullopt},
+                                    .name        = {.plain = name, .qualified = qualifiedName, .namespace_ = std::nullopt},
+                                    .isConst     = type.isConstQualified(),
+                                    .isPointer   = type->isPointerType(),
+                                    .isReference = type->isReferenceType(),
+                                    .functionals = {},
+                                    .typeIndex   = spelling.index};
+    }
+
+    void addFields(const clang::CXXRecordDecl *declaration, StructInfo &info) const {
+        info.hasAllFields = !hasInheritedFields(declaration);
+        for (const auto *field : declaration->fields()) {
+            if (filter_ != nullptr && !filter_->acceptsAccess(field->getAccess())) {
+                info.hasAllFields = false;
+                continue;
+            }
+            auto fieldInfo     = createFieldInfo(field->getType(), field->getName().str(), field->getQualifiedNameAsString());
+            fieldInfo.isPublic = field->getAccess() == clang::AccessSpecifier::AS_public;
+            info.members.emplace_back(fieldInfo);
+        }
+    }
+
+    /**
+     * @brief Whether a base class, directly or through its own bases, has data members.
+     */
+    static bool hasInheritedFields(const clang::CXXRecordDecl *declaration) {
+        return std::any_of(declaration->bases_begin(), declaration->bases_end(), [](const clang::CXXBaseSpecifier &base) {
+            const auto *record = base.getType()->getAsCXXRecordDecl();
+            return record == nullptr || !record->hasDefinition() || !record->field_empty() || hasInheritedFields(record);
+        });
+    }
+
+    /**
+     * @brief Records how the class can be constructed: its bindable constructors, or whether it is an aggregate.
+     *
+     * Aggregates are only recorded if brace initialization from the extracted fields covers the whole object: no
+     * bases, no unions, and named, non-array, non-reference fields.
+     */
+    void addConstructors(const clang::CXXRecordDecl *declaration, StructInfo &info) const {
+        if (!declaration->hasDefinition()) {
+            return;
+        }
+
+        bool defaultConstructorUsable = true;
+        for (const auto *constructor : declaration->ctors()) {
+            if (constructor->isImplicit()) {
+                continue;
+            }
+            bool usable = !constructor->isDeleted() && constructor->getAccess() == clang::AccessSpecifier::AS_public;
+            if (constructor->isDefaultConstructor()) {
+                defaultConstructorUsable = defaultConstructorUsable && usable;
+            }
+            if (!usable || constructor->isCopyOrMoveConstructor() || constructor->getNumParams() == 0) {
+                continue;
+            }
+
+            info.constructors.push_back(extractFunction(constructor, info.definingFile));
+        }
+
+        // An implicit default constructor is deleted e.g. by reference members without initializer
+        info.isDefaultConstructible =
+            declaration->hasDefaultConstructor() && defaultConstructorUsable &&
+            !(declaration->needsImplicitDefaultConstructor() && declaration->defaultedDefaultConstructorIsDeleted());
+
+        auto fieldCount  = static_cast<size_t>(std::distance(declaration->field_begin(), declaration->field_end()));
+        info.isAggregate = declaration->isAggregate() && !declaration->isUnion() && declaration->getNumBases() == 0 && fieldCount > 0 &&
+                           info.members.size() == fieldCount;
+        for (const auto *field : declaration->fields()) {
+            info.isAggregate = info.isAggregate && !field->isAnonymousStructOrUnion() && !field->getName().empty() &&
+                               !field->getType()->isArrayType() && !field->getType()->isReferenceType();
+        }
+    }
+
+    FunctionInfo extractFunction(const clang::FunctionDecl *declaration, std::string definingFile) const {
         FunctionInfo info;
-        info.name       = createDeclarationName(declaration);
-        info.namespace_ = getNamespaceFromContext(declaration->getDeclContext());
+        info.name         = createDeclarationName(declaration);
+        info.namespace_   = getNamespaceFromContext(declaration->getDeclContext());
+        info.definingFile = std::move(definingFile);
 
-        info.returnType = {.plain      = declaration->getReturnType().getAsString(),
-                           .qualified  = declaration->getReturnType().getCanonicalType().getAsString(),
-                           .namespace_ = std::nullopt};
+        const auto &returnType = spell(declaration->getReturnType());
+        info.returnType        = {.plain = returnType.plain, .qualified = returnType.canonical, .namespace_ = std::nullopt};
+        info.returnTypeIndex   = returnType.index;
 
         if (auto *method = llvm::dyn_cast<clang::CXXMethodDecl>(declaration)) {
             info.isMemberFunction = true;
+            info.isConst          = method->isConst();
             info.parent           = createDeclarationName(method->getParent());
         } else {
             info.parent           = std::nullopt;
@@ -208,91 +593,31 @@ class Visitor : public clang::RecursiveASTVisitor<Visitor> {
         info.isStatic      = declaration->isStatic();
 
         for (const auto *param : declaration->parameters()) {
+            const auto          &type = spell(param->getType());
             FieldDeclarationInfo fieldInfo;
-
-            using namespace clang;
-            QualType paramType = param->getType();
-
-            // Get the CXXRecordDecl if this is a class/struct type
-            if (const CXXRecordDecl *recordDecl = paramType->getAsCXXRecordDecl()) {
-                // Check if this is a template specialization
-                if (const auto *templateDecl = dyn_cast<ClassTemplateSpecializationDecl>(recordDecl)) {
-
-                    // Check if this is std::function
-                    if (templateDecl->getIdentifier()->getName() == "function") {
-                        // Get the template arguments
-                        const TemplateArgumentList &args = templateDecl->getTemplateArgs();
-                        if (args.size() > 0) {
-                            // The first argument should be the function type
-                            if (args[0].getKind() == TemplateArgument::Type) {
-                                QualType functionType = args[0].getAsType();
-
-                                // Get the actual function type
-                                if (const auto *protoType = functionType->getAs<FunctionProtoType>()) {
-                                    // Get return type
-                                    QualType returnType = protoType->getReturnType();
-
-                                    // TODO: fix dirty hack cleaning the type names
-                                    // Remove 'struct' or 'class' prefixes if present
-                                    auto cleanTypeName = [](std::string &type) {
-                                        const std::array<std::string, 2> prefixes = {"struct ", "class "};
-                                        for (const auto &prefix : prefixes) {
-                                            if (type.substr(0, prefix.length()) == prefix) {
-                                                type = type.substr(prefix.length());
-                                            }
-                                        }
-                                    };
-
-                                    FunctionInfo functionalInfo;
-                                    functionalInfo.returnType.plain     = returnType.getAsString();
-                                    functionalInfo.returnType.qualified = returnType.getCanonicalType().getAsString();
-
-                                    cleanTypeName(functionalInfo.returnType.plain);
-                                    cleanTypeName(functionalInfo.returnType.qualified);
-
-                                    // Get parameter types
-                                    for (const QualType &argType : protoType->getParamTypes()) {
-                                        FieldDeclarationInfo paramInfo;
-                                        paramInfo.type.plain     = argType.getAsString();
-                                        paramInfo.type.qualified = argType.getCanonicalType().getAsString();
-
-                                        cleanTypeName(paramInfo.type.plain);
-                                        cleanTypeName(paramInfo.type.qualified);
-
-                                        paramInfo.isConst     = argType.isConstQualified();
-                                        paramInfo.isPointer   = argType->isPointerType();
-                                        paramInfo.isReference = argType->isReferenceType();
-
-                                        functionalInfo.parameters.emplace_back(paramInfo);
-                                    }
-
-                                    // Store the functional info
-                                    fieldInfo.isFunctional = true;
-                                    fieldInfo.functionals.emplace_back(functionalInfo);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-
-            fieldInfo.type.plain     = param->getType().getAsString();
-            fieldInfo.type.qualified = param->getType().getCanonicalType().getAsString();
+            fieldInfo.type.plain     = type.plain;
+            fieldInfo.type.qualified = type.fullyQualified;
+            fieldInfo.typeIndex      = type.index;
             fieldInfo.name.plain     = param->getName();
             fieldInfo.name.qualified = param->getQualifiedNameAsString();
-            info.parameters.emplace_back(fieldInfo);
+            if (auto functional = functionalSignature(type.index)) {
+                fieldInfo.isFunctional = true;
+                fieldInfo.functionals.push_back(std::move(*functional));
+            }
+            info.parameters.emplace_back(std::move(fieldInfo));
         }
-        functions_.push_back(info);
-
-        return true;
+        return info;
     }
 
-    ~Visitor() { cb_(std::move(structs_), std::move(functions_)); }
+    clang::ASTContext       *context_;
+    VisitCompleteCallback    cb_;
+    const DeclarationFilter *filter_;
+    std::string              stringBuffer_;
+    clang::PrintingPolicy    policy_; // C++ spellings: no tag keywords, bool instead of _Bool
 
-  private:
-    clang::ASTContext    *context_;
-    VisitCompleteCallback cb_;
-    std::string           stringBuffer_;
+    // Per translation unit caches, keyed by QualType::getAsOpaquePtr() (types are uniqued by the ASTContext)
+    mutable std::unordered_map<const void *, TypeSpelling> spellings_;   // Sugared types, references stay valid
+    mutable std::unordered_map<const void *, TypeIndex>    typeIndices_; // Canonical types
 
     std::vector<StructInfo>   structs_;
     std::vector<FunctionInfo> functions_;
@@ -0,0 +1,34 @@
+// Counts the heap allocations made by the code of the benchmark module: pybind11's casters and the std containers
+// instantiated in it. Linked into the module only, so the counter does not see the interpreter's own allocations.
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#define CPPGLUE_BENCH_EXPORT __declspec(dllexport)
+#else
+#define CPPGLUE_BENCH_EXPORT __attribute__((visibility("default")))
+#endif
+
+namespace {
+std::atomic<std::uint64_t> allocations{0};
+
+void *allocate(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+} // namespace
+
+void *operator new(std::size_t size) { return allocate(size); }
+void *operator new[](std::size_t size) { return allocate(size); }
+void  operator delete(void *memory) noexcept { std::free(memory); }
+void  operator delete[](void *memory) noexcept { std::free(memory); }
+void  operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+void  operator delete[](void *memory, std::size_t) noexcept { std::free(memory); }
+
+// Read by bench.py through ctypes
+extern "C" CPPGLUE_BENCH_EXPORT std::uint64_t cppglue_bench_allocations() { return allocations.load(std::memory_order_relaxed); }
@@ -0,0 +1,145 @@
+"""Bound-call overhead benchmark for the bindings py-gen generates from corpus.h.
+
+Reports, per case, the time per call (best of --repeat runs of --number calls) and the C++ heap allocations per
+call made by the module's code (see allocation_counter.cpp). With --baseline, exits with status 1 if a case is
+slower than the baseline by more than --tolerance or allocates more.
+
+    python bench.py --module-dir <dir of cppglue_bench.so> [--output results.json] [--baseline old.json]
+"""
+
+import argparse
+import ctypes
+import json
+import platform
+import sys
+import timeit
+
+MODULE = "cppglue_bench"
+
+# name -> (setup, statement), run with the module's names and `m` (the module) in scope
+CASES = {
+    "python_noop": ("def f(): pass", "f()"),
+    "free_noop": ("", "noop()"),
+    "free_int_add": ("", "add(1, 2)"),
+    "free_double_scale": ("", "scale(1.5, 2.0)"),
+    "free_bool_negate": ("", "negate(True)"),
+    "enum_roundtrip": ("c = Color.Green", "next_color(c)"),
+    "string_arg": ("s = 'x' * 64", "text_length(s)"),
+    "string_roundtrip": ("s = 'x' * 64", "echo(s)"),
+    "vector_arg_100": ("v = [float(i) for i in range(100)]", "sum(v)"),
+    "vector_result_100": ("", "make_range(100)"),
+    "complex_roundtrip": ("z = complex(1.0, 2.0)", "conjugate(z)"),
+    "overload_vector_100": ("v = [float(i) for i in range(100)]", "pick(v)"),
+    "overload_string": ("s = 'x' * 64", "pick(s)"),
+    "overload_double": ("", "pick(1.5)"),
+    "overload_int": ("", "pick(1)"),
+    "callback_into_python": ("cb = lambda x: x + 1", "call_with(cb, 1)"),
+    "method_const": ("p = Point(); p.x = 3.0; p.y = 4.0", "p.length_squared()"),
+    "method_mutating": ("p = Point(); p.x = 0.0; p.y = 0.0", "p.translate(1.0, 1.0)"),
+    "method_string_result": ("r = Record(); r.name = 'record'; r.id = 7", "r.describe()"),
+    "field_get_double": ("p = Point(); p.x = 1.0", "p.x"),
+    "field_set_double": ("p = Point()", "p.x = 1.0"),
+    "field_get_string": ("r = Record(); r.name = 'x' * 64", "r.name"),
+    "field_set_string": ("r = Record(); s = 'x' * 64", "r.name = s"),
+    "field_get_vector_100": ("r = Record(); r.values = [float(i) for i in range(100)]", "r.values"),
+    "field_set_vector_100": ("r = Record(); v = [float(i) for i in range(100)]", "r.values = v"),
+    "field_get_complex": ("r = Record(); r.phase = complex(1.0, 2.0)", "r.phase"),
+    "field_set_complex": ("r = Record(); z = complex(1.0, 2.0)", "r.phase = z"),
+    "field_get_enum": ("r = Record(); r.color = Color.Blue", "r.color"),
+    "field_set_enum": ("r = Record(); c = Color.Blue", "r.color = c"),
+    "field_callback_notify": ("r = Record(); r.on_change = lambda v: None", "r.notify(1)"),
+}
+
+
+def load_module(module_dir):
+    sys.path.insert(0, module_dir)
+    module = __import__(MODULE)
+    counter = ctypes.CDLL(module.__file__).cppglue_bench_allocations
+    counter.restype = ctypes.c_uint64
+    return module, counter
+
+
+def run_case(module, counter, setup, statement, number, repeat):
+    namespace = dict(vars(module))
+    namespace["m"] = module
+    exec(setup, namespace)
+    timer = timeit.Timer(statement, globals=namespace)
+
+    timer.timeit(number=min(number, 1000))  # warm up
+    before = counter()
+    best = min(timer.repeat(repeat=repeat, number=number))
+    allocations = counter() - before
+
+    return {
+        "ns_per_call": best / number * 1e9,
+        "allocations_per_call": allocations / (number * repeat),
+    }
+
+
+def compare(results, baseline, tolerance):
+    regressions = []
+    for name, result in results.items():
+        old = baseline.get(name)
+        if old is None:
+            print(f"  {name}: not in the baseline")
+            continue
+        if result["ns_per_call"] > old["ns_per_call"] * (1.0 + tolerance):
+            regressions.append(f"{name}: {old['ns_per_call']:.1f} -> {result['ns_per_call']:.1f} ns/call")
+        if result["allocations_per_call"] > old["allocations_per_call"] + 0.01:
+            regressions.append(
+                f"{name}: {old['allocations_per_call']:.2f} -> {result['allocations_per_call']:.2f} allocations/call"
+            )
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--module-dir", required=True, help="directory containing the built cppglue_bench module")
+    parser.add_argument("--number", type=int, default=100000, help="calls per run")
+    parser.add_argument("--repeat", type=int, default=5, help="runs per case, the fastest is reported")
+    parser.add_argument("--filter", default="", help="only run cases whose name contains this")
+    parser.add_argument("--output", help="write the results as JSON, usable as a later --baseline")
+    parser.add_argument("--baseline", help="results of an earlier run to compare against")
+    parser.add_argument("--tolerance", type=float, default=0.10, help="allowed slowdown against the baseline")
+    args = parser.parse_args()
+
+    module, counter = load_module(args.module_dir)
+
+    results = {}
+    print(f"{'case':<24} {'ns/call':>10} {'allocs/call':>12}")
+    for name, (setup, statement) in CASES.items():
+        if args.filter not in name:
+            continue
+        results[name] = run_case(module, counter, setup, statement, args.number, args.repeat)
+        print(f"{name:<24} {results[name]['ns_per_call']:>10.1f} {results[name]['allocations_per_call']:>12.2f}")
+
+    if hasattr(module, "_cppglue_stats"):
+        print("\nModule built with instrument = true, timings include the instrumentation")
+
+    if args.output:
+        with open(args.output, "w") as file:
+            json.dump(
+                {
+                    "python": platform.python_version(),
+                    "machine": platform.machine(),
+                    "cases": results,
+                },
+                file,
+                indent=2,
+            )
+
+    if args.baseline:
+        with open(args.baseline) as file:
+            baseline = json.load(file)["cases"]
+        print(f"\nComparing against {args.baseline} (tolerance {args.tolerance:.0%})")
+        regressions = compare(results, baseline, args.tolerance)
+        for regression in regressions:
+            print(f"  REGRESSION {regression}")
+        if regressions:
+            return 1
+        print("  no regressions")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
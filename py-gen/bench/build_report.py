@@ -0,0 +1,147 @@
+"""Build cost of the module py-gen generates from corpus.h, with and without the [build] options.
+
+Generates the module once per variant, builds the generated CMakeLists.txt in a clean Release build directory and
+reports the wall time of the build (configuring excluded, best of --repeat clean builds) and the size of the built
+module.
+
+    python build_report.py --py-gen <py-gen> --corpus-dir <py-gen/bench> --work-dir <dir>
+                           --pybind11-dir <pybind11 source> [--output report.json]
+"""
+
+import argparse
+import glob
+import json
+import os
+import platform
+import shutil
+import subprocess
+import sys
+import time
+
+MODULE = "cppglue_build_report"
+
+# variant -> [build] table of the config, empty for the defaults
+VARIANTS = {
+    "default": "",
+    "build": "\n".join(
+        [
+            "[build]",
+            "precompile_headers = true",
+            "unity_batch_size = 8",
+            "hidden_visibility = true",
+            "thin_lto = true",
+            "gc_sections = true",
+        ]
+    ),
+}
+
+# Builds the generated project with the corpus' include directory, without downloading pybind11 again
+WRAPPER = """cmake_minimum_required(VERSION 3.16)
+project(build_report)
+add_subdirectory(module)
+target_include_directories({module} PRIVATE "{corpus_dir}")
+"""
+
+
+def generate(args, variant, directory):
+    module_dir = os.path.join(directory, "module")
+    config = os.path.join(directory, "config.toml")
+    with open(config, "w") as file:
+        file.write(
+            "\n".join(
+                [
+                    f"sources = [{json.dumps(os.path.join(args.corpus_dir, 'corpus.cpp'))}]",
+                    f'module_name = "{MODULE}"',
+                    f"output_dir = {json.dumps(module_dir)}",
+                    f"compile_args = [{args.compile_args}]",
+                    "print_info = false",
+                    VARIANTS[variant],
+                    "",
+                ]
+            )
+        )
+    subprocess.run([args.py_gen, "-c", config], check=True, cwd=directory, stdout=subprocess.DEVNULL)
+
+    with open(os.path.join(directory, "CMakeLists.txt"), "w") as file:
+        file.write(WRAPPER.format(module=MODULE, corpus_dir=args.corpus_dir.replace("\\", "/")))
+
+
+def build(args, directory):
+    build_dir = os.path.join(directory, "build")
+    shutil.rmtree(build_dir, ignore_errors=True)
+
+    configure = [args.cmake, "-S", directory, "-B", build_dir, "-DCMAKE_BUILD_TYPE=Release"]
+    configure += [f"-DCPM_pybind11_SOURCE={args.pybind11_dir}", f"-DPython_EXECUTABLE={sys.executable}"]
+    if args.generator:
+        configure += ["-G", args.generator]
+    subprocess.run(configure, check=True, stdout=subprocess.DEVNULL)
+
+    start = time.perf_counter()
+    subprocess.run(
+        [args.cmake, "--build", build_dir, "--config", "Release", "-j", str(args.jobs)], check=True, stdout=subprocess.DEVNULL
+    )
+    seconds = time.perf_counter() - start
+
+    modules = [
+        path
+        for pattern in (f"{MODULE}*.so", f"{MODULE}*.pyd")
+        for path in glob.glob(os.path.join(build_dir, "**", pattern), recursive=True)
+    ]
+    if not modules:
+        raise RuntimeError(f"No {MODULE} module found in {build_dir}")
+    return seconds, os.path.getsize(modules[0])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--py-gen", required=True, help="the py-gen executable")
+    parser.add_argument("--corpus-dir", required=True, help="directory of corpus.h and corpus.cpp")
+    parser.add_argument("--work-dir", required=True, help="directory the variants are generated and built in")
+    parser.add_argument("--pybind11-dir", required=True, help="pybind11 source directory the modules are built with")
+    parser.add_argument(
+        "--compile-args", default='"-xc++", "-std=c++20"', help="compile_args of the config, as TOML array items"
+    )
+    parser.add_argument("--cmake", default="cmake", help="the cmake executable")
+    parser.add_argument("--generator", default="", help="CMake generator of the module builds")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count() or 1, help="parallel build jobs")
+    parser.add_argument("--repeat", type=int, default=3, help="clean builds per variant, the fastest is reported")
+    parser.add_argument("--output", help="write the report as JSON")
+    args = parser.parse_args()
+    # py-gen runs in the directory of each variant
+    args.py_gen = os.path.abspath(args.py_gen) if os.path.exists(args.py_gen) else shutil.which(args.py_gen)
+    args.corpus_dir, args.work_dir = os.path.abspath(args.corpus_dir), os.path.abspath(args.work_dir)
+
+    results = {}
+    print(f"{'variant':<10} {'build s':>10} {'module bytes':>14}")
+    for variant in VARIANTS:
+        directory = os.path.join(args.work_dir, variant)
+        os.makedirs(directory, exist_ok=True)
+        generate(args, variant, directory)
+
+        runs = [build(args, directory) for _ in range(args.repeat)]
+        results[variant] = {"build_seconds": min(seconds for seconds, _ in runs), "module_bytes": runs[-1][1]}
+        print(f"{variant:<10} {results[variant]['build_seconds']:>10.2f} {results[variant]['module_bytes']:>14}")
+
+    default, options = results["default"], results["build"]
+    print(
+        f"\n[build] changes the build time by {options['build_seconds'] / default['build_seconds'] - 1.0:+.0%}"
+        f" and the module size by {options['module_bytes'] / default['module_bytes'] - 1.0:+.0%}"
+    )
+
+    if args.output:
+        with open(args.output, "w") as file:
+            json.dump(
+                {
+                    "python": platform.python_version(),
+                    "machine": platform.machine(),
+                    "jobs": args.jobs,
+                    "variants": results,
+                },
+                file,
+                indent=2,
+            )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
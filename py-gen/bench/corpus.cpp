@@ -0,0 +1,2 @@
+// Source given to py-gen, the generated module includes the headers included here
+#include "corpus.h"
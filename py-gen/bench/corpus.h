@@ -0,0 +1,85 @@
+#pragma once
+
+// Fixed corpus for the bound-call benchmark (bench.py). Keep it stable: changing a declaration changes what the
+// baseline measured. Add new cases instead, bench.py reports cases missing from the baseline separately.
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+enum class Color : int { Red, Green, Blue };
+
+// Scalar free functions
+inline void   noop() {}
+inline int    add(int a, int b) { return a + b; }
+inline double scale(double value, double factor) { return value * factor; }
+inline bool   negate(bool value) { return !value; }
+
+// Enum conversions
+inline Color next_color(Color color) { return static_cast<Color>((static_cast<int>(color) + 1) % 3); }
+
+// Strings, containers and complex numbers
+inline std::size_t          text_length(const std::string &text) { return text.size(); }
+inline std::string          echo(const std::string &text) { return text; }
+inline std::complex<double> conjugate(std::complex<double> value) { return std::conj(value); }
+
+inline double sum(const std::vector<double> &values) {
+    double total = 0.0;
+    for (double value : values) {
+        total += value;
+    }
+    return total;
+}
+
+inline std::vector<int> make_range(int count) {
+    std::vector<int> range(static_cast<std::size_t>(count));
+    for (int i = 0; i < count; ++i) {
+        range[static_cast<std::size_t>(i)] = i;
+    }
+    return range;
+}
+
+// Overloads, declared with the common integer case last: without order_overloads it is tried last
+inline std::size_t  pick(const std::vector<double> &values) { return values.size(); }
+inline std::size_t  pick(const std::string &text) { return text.size(); }
+inline double       pick(double value) { return value; }
+inline std::int64_t pick(std::int64_t value) { return value; }
+
+// Callbacks from C++ into Python
+inline int call_with(const std::function<int(int)> &callback, int value) { return callback(value); }
+
+struct Point {
+    double x;
+    double y;
+
+    double length_squared() const { return x * x + y * y; }
+
+    void translate(double dx, double dy) {
+        x += dx;
+        y += dy;
+    }
+};
+
+struct Record {
+    std::int64_t             id;
+    std::string              name;
+    std::vector<double>      values;
+    std::complex<double>     phase;
+    Color                    color;
+    std::function<void(int)> on_change;
+
+    std::string describe() const { return name + "#" + std::to_string(id); }
+
+    void notify(int value) const {
+        if (on_change) {
+            on_change(value);
+        }
+    }
+};
+
+} // namespace bench
@@ -0,0 +1,22 @@
+# Writes every *.template file in TEMPLATE_DIR as one {"<file name>", R"...(<content>)..."} initializer into OUTPUT.
+# Run in script mode: cmake -DTEMPLATE_DIR=<dir> -DOUTPUT=<file> -P embed_templates.cmake
+set(DELIMITER "pygen_template")
+
+file(GLOB TEMPLATE_FILES "${TEMPLATE_DIR}/*.template")
+list(SORT TEMPLATE_FILES)
+
+set(CONTENT "// Generated from ${TEMPLATE_DIR} by embed_templates.cmake, do not edit\n")
+foreach(template_file IN LISTS TEMPLATE_FILES)
+  get_filename_component(template_name ${template_file} NAME)
+  file(READ ${template_file} template_text)
+  string(FIND "${template_text}" ")${DELIMITER}\"" delimiter_pos)
+  if(NOT delimiter_pos EQUAL -1)
+    message(FATAL_ERROR "${template_file} contains the raw string delimiter )${DELIMITER}\"")
+  endif()
+  string(APPEND CONTENT "{\"${template_name}\", R\"${DELIMITER}(${template_text})${DELIMITER}\"},\n")
+endforeach()
+
+# Only touch the output if it changed, so the generator is not recompiled needlessly
+file(WRITE ${OUTPUT}.tmp "${CONTENT}")
+file(COPY_FILE ${OUTPUT}.tmp ${OUTPUT} ONLY_IF_DIFFERENT)
+file(REMOVE ${OUTPUT}.tmp)
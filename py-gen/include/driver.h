@@ -0,0 +1,29 @@
+#pragma once
+
+#include "extraction_session.hpp"
+#include "program_options.h"
+
+/**
+ * @brief Builds the extraction request (sources, compile args, compile_commands.json) for the given options.
+ */
+ExtractionRequest makeExtractionRequest(const ProgramOptions &options);
+
+/**
+ * @brief Runs extraction and binding generation for one parsed config.
+ *
+ * @param options Options parsed from the command line and config file
+ * @param session Session to run the extraction in, reusing its caches between calls
+ * @return 0 on success, non-zero otherwise
+ */
+int runGenerator(const ProgramOptions &options, ExtractionSession &session);
+
+/**
+ * @brief Generates the bindings from IR files written by --export instead of parsing sources (`py-gen merge`).
+ *
+ * The inputs are either the complete set of shards of one sharded extraction (any order) or unsharded exports.
+ * Declarations found in several inputs are kept once.
+ *
+ * @param options Options parsed from the command line and config file, mergeInputs are the IR files
+ * @return 0 on success, non-zero otherwise
+ */
+int runMerge(const ProgramOptions &options);
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+namespace llvm {
+class MemoryBuffer;
+class raw_fd_ostream;
+} // namespace llvm
+
+/**
+ * @brief Hashes of the files generated into one output directory, stored in `.py-gen-manifest`.
+ *
+ * An entry is only trusted while the file on disk still has the recorded size and modification time, so a file
+ * edited by hand is compared byte by byte again.
+ */
+class HashManifest {
+  public:
+    struct Entry {
+        uint64_t  hash{0};
+        uintmax_t size{0};
+        int64_t   modified{0}; // Nanoseconds since the file clock epoch
+    };
+
+    explicit HashManifest(std::filesystem::path directory);
+
+    /**
+     * @brief Returns the entry for a file, if there is one and the file was not modified since it was recorded.
+     */
+    [[nodiscard]] std::optional<Entry> lookup(const std::filesystem::path &file) const;
+
+    /**
+     * @brief Records the hash of a file as it is on disk now.
+     */
+    void update(const std::filesystem::path &file, uint64_t hash);
+
+    /**
+     * @brief Writes the manifest back if any entry changed.
+     */
+    void save() const;
+
+  private:
+    [[nodiscard]] std::string key(const std::filesystem::path &file) const;
+
+    std::filesystem::path        directory_;
+    std::map<std::string, Entry> entries_;
+    bool                         dirty_{false};
+};
+
+/**
+ * @brief Stream buffer writing through a fixed size buffer into a temporary file next to the target.
+ *
+ * Every flushed chunk updates an incremental FNV-1a hash and, unless the manifest vouches for the existing file, is
+ * compared against the memory mapped existing file. Peak memory is the buffer size, however large the output gets.
+ */
+class StreamingFileBuffer : public std::streambuf {
+  public:
+    StreamingFileBuffer(std::filesystem::path path, HashManifest *manifest);
+    ~StreamingFileBuffer() override;
+
+    StreamingFileBuffer(const StreamingFileBuffer &)            = delete;
+    StreamingFileBuffer &operator=(const StreamingFileBuffer &) = delete;
+
+    /**
+     * @brief Flushes the remaining output and replaces the target atomically (rename) if the content changed.
+     * @return true if the file was written, false if it was already up to date
+     * @throws std::runtime_error if the output could not be written
+     */
+    bool commit();
+
+  protected:
+    int_type overflow(int_type ch) override;
+    int      sync() override;
+
+  private:
+    void openTemporary();
+    void flushChunk();
+
+    static constexpr size_t bufferSize = 64 * 1024;
+
+    std::filesystem::path                 path_;
+    std::filesystem::path                 temporaryPath_;
+    HashManifest                         *manifest_;
+    std::optional<HashManifest::Entry>    previous_; // Manifest entry for the existing file, if still valid
+    std::unique_ptr<llvm::MemoryBuffer>   existing_; // Mapped existing file, only used without a valid manifest entry
+    std::unique_ptr<llvm::raw_fd_ostream> temporary_; // Opened on the first chunk that has to be written
+    std::array<char, bufferSize>          buffer_{};
+    uint64_t                              hash_;
+    uintmax_t                             written_{0};
+    bool                                  identical_;
+    bool                                  committed_{false};
+};
+
+/**
+ * @brief Output stream writing a generated file through a StreamingFileBuffer.
+ *
+ * @code
+ * StreamingFile file(outputDir / "module.cpp", &manifest);
+ * file << ...;
+ * file.commit();
+ * @endcode
+ * Destroying the stream without commit() discards the output and leaves the existing file untouched.
+ */
+class StreamingFile : public std::ostream {
+  public:
+    StreamingFile(const std::filesystem::path &path, HashManifest *manifest = nullptr);
+
+    bool commit();
+
+  private:
+    StreamingFileBuffer buffer_;
+};
+
+class FileWriter {
+  public:
+    /**
+     * @brief Writes content to path unless the file already has exactly that content, keeping its modification time.
+     */
+    static void writeIfDifferent(const std::filesystem::path &path, const std::string &content, HashManifest *manifest = nullptr);
+
+    /**
+     * @brief Commits a streamed file and reports whether it was generated or skipped.
+     */
+    static void commit(StreamingFile &file, const std::filesystem::path &path);
+
+    static void ensureDirectory(const std::filesystem::path &path);
+};
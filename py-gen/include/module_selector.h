@@ -0,0 +1,38 @@
+#pragma once
+
+#include "declaration_filter.hpp"
+#include "visitor.hpp"
+
+#include <optional>
+#include <string>
+#include <utility>
+
+/**
+ * @brief Selection rules deciding which extracted declarations belong to a module.
+ *
+ * The rules are include rules of a DeclarationFilter: namespaces (qualified name prefixes), headers (globs on the
+ * real path of the defining file) and names (regexes on the qualified name). Each kind matches if any of its
+ * entries matches, an empty kind matches everything. Member functions follow their class.
+ */
+struct ModuleSelector {
+    std::optional<DeclarationFilter> filter; // Selects everything if empty
+
+    [[nodiscard]] bool selectsEverything() const noexcept { return !filter.has_value(); }
+    [[nodiscard]] bool selects(const std::string &qualifiedName, const std::string &definingFile) const {
+        return !filter || filter->accepts(qualifiedName, definingFile);
+    }
+};
+
+/**
+ * @brief One Python module to generate from the shared extraction.
+ */
+struct ModuleConfig {
+    std::string    moduleName;
+    std::string    outputDir = ".";
+    ModuleSelector selector;
+};
+
+/**
+ * @brief Copies the declarations selected for one module out of the extraction results.
+ */
+std::pair<Structs, Functions> selectForModule(const Structs &structs, const Functions &functions, const ModuleSelector &selector);
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "ir_export.hpp"
+#include "program_options.h"
+#include "py-gen.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <llvm/ADT/StringSet.h>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Generates the bindings while extraction is still running.
+ *
+ * The extraction callbacks only queue the declarations of each translation unit. A worker thread consumes the queue:
+ * it writes the export, drops the copies of declarations seen in an earlier translation unit and sorts the rest into
+ * the shards (see BindingShard) of every module. Whenever the queue runs empty the worker renders the shards that got
+ * new declarations, so the bindings of the namespaces parsed so far are generated while clang parses the next source.
+ *
+ * Shards can only be finalized once all sources are parsed: a namespace may be reopened by a later header, and whether
+ * a struct is picklable depends on the structs of other namespaces. generate() renders, in parallel, only the shards
+ * that changed since, or whose picklable structs turned out different from the guess made from the shard alone.
+ * The .pyi stub and the files shared by all shards are written by generate() as well.
+ *
+ * All declarations are kept in memory, the memory budget of IRCollector does not apply.
+ */
+class BindingPipeline {
+  public:
+    /**
+     * @param options The modules and generator options, shardBindings is implied
+     * @param exporter Export written by the worker thread, nullptr for none
+     */
+    BindingPipeline(const ProgramOptions &options, IRExporter *exporter);
+    ~BindingPipeline();
+
+    BindingPipeline(const BindingPipeline &)            = delete;
+    BindingPipeline &operator=(const BindingPipeline &) = delete;
+
+    /**
+     * @brief Queues the declarations of a translation unit, see VisitCompleteCallback.
+     */
+    void addDeclarations(Structs &&structs, Functions &&functions);
+
+    /**
+     * @brief Queues the headers of a translation unit, see HeaderCallback.
+     */
+    void addHeaders(Headers &&headers);
+
+    /**
+     * @brief Waits until the worker processed the queue and stops it.
+     * @throws std::exception The error the worker stopped with, e.g. failing to write the export
+     */
+    void finish();
+
+    /**
+     * @brief Renders the remaining shards and writes the files of every module, after finish().
+     */
+    void generate();
+
+  private:
+    struct Batch {
+        Structs                structs;
+        Functions              functions;
+        std::optional<Headers> headers; // Set for the batch of a HeaderCallback
+    };
+
+    struct Module {
+        const ModuleConfig   *config;
+        ShardPartition        partition;
+        std::vector<size_t>   structs;   // Indices of the selected declarations, in extraction order
+        std::vector<size_t>   functions;
+        std::set<std::string> parents;   // Selected classes, their member functions are selected with them
+        std::vector<size_t>   orphans;   // Member functions of classes not selected (yet)
+    };
+
+    void run();
+    void process(Batch &batch);
+    void select(Module &module, size_t function);
+    bool renderNext();
+
+    const ProgramOptions &options_;
+    GeneratorOptions      generator_;
+    IRExporter           *exporter_;
+
+    // Owned by the worker thread until finish()
+    Structs             structs_;
+    Functions           functions_;
+    Headers             headers_;
+    llvm::StringSet<>   seen_; // declarationKey of everything kept
+    std::vector<Module> modules_;
+
+    std::mutex              mutex_;
+    std::condition_variable queued_;
+    std::deque<Batch>       queue_;
+    bool                    finishing_{false};
+    std::exception_ptr      error_;
+    std::thread             worker_;
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "module_selector.h"
+#include "py-gen.h"
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <toml++/toml.h>
+#include <vector>
+
+struct ProgramOptions {
+    std::string              moduleName;
+    std::string              outputDir = ".";
+    std::filesystem::path    configFile;
+    std::filesystem::path    compileCommandsFile;
+    std::vector<std::string> sources;
+    std::vector<std::string> compileArgs;
+
+    // Class template instantiations extracted as structs of their own, see Instantiation
+    std::vector<Instantiation> instantiations;
+
+    // Declarations excluded during traversal, nullptr if the config has no [filter]
+    std::shared_ptr<const DeclarationFilter> filter;
+
+    // Directory with customized *.template files, the embedded templates are used for any not found there
+    std::filesystem::path templateDir;
+
+    // Modules generated from the one extraction, a config without [[modules]] yields module_name and output_dir
+    std::vector<ModuleConfig> modules;
+
+    // Options of the generated code, shared by all modules
+    GeneratorOptions generator;
+
+    // IR export, see ir_export.hpp
+    std::filesystem::path exportFile;
+    std::string           exportFormat;      // "json", "msgpack" or empty to pick it from the file extension
+    bool                  exportOnly{false}; // Only export, no bindings are generated and no declarations kept in memory
+
+    // Bounded memory mode, see IRCollector: IR beyond the budget is spilled to disk until extraction finished
+    size_t                memoryBudget{0}; // Bytes, 0 keeps everything in memory
+    std::filesystem::path spillDir;        // Defaults to the system temporary directory
+
+    // Sharded extraction: this process handles every shardCount-th source starting at shardIndex and exports the
+    // result (see ExtractionRequest), `py-gen merge` combines the shard exports and generates the bindings
+    size_t                   shardIndex{0};
+    size_t                   shardCount{1};
+    bool                     merge{false};
+    std::vector<std::string> mergeInputs;
+
+    // Print the extracted declarations (printInfo), slow for large outputs
+    bool printInfo{true};
+
+    // Generate sharded bindings while extracting, see BindingPipeline
+    bool pipeline{false};
+
+    // Make/Ninja depfile listing the files the run read, its target is the bindings source of the first module (the
+    // export file if no bindings are generated), see cmake/cppglue_add_python_module.cmake
+    std::filesystem::path depfile;
+
+    // Server mode, see server.h
+    std::filesystem::path serveSocket;
+    std::filesystem::path connectSocket;
+
+    // Watch mode, see watch.h
+    bool watch{false};
+};
+
+/**
+ * @brief Parses command line arguments to configure the Python binding generator.
+ *
+ * This function uses the cxxopts library to parse command line arguments and populate
+ * a ProgramOptions structure with the provided values. It supports the following options:
+ *
+ * - `-c, --config <file>`: Specifies a TOML configuration file containing:
+ *   - compile_commands: Path to compile_commands.json
+ *   - sources: Array of source files to process
+ *   - compile_args: Array of compiler arguments
+ *   - module_name: Name of the output Python module
+ *   - output_dir: Directory for generated files (default: ".")
+ *   - [[modules]]: Optional array of modules generated from the same extraction, each with module_name, output_dir
+ *     and the selection rules namespaces (qualified name prefixes), headers (globs on the defining file) and
+ *     names (regexes on the qualified name)
+ *   - instantiations: Class template instantiations to bind, each a type ("alpha::Matrix<float>") or a table with
+ *     type, name (the Python name, default derived from the type: Matrix_float) and header (declaring the template,
+ *     default all header sources)
+ *   - memory_budget_mb: Spill the extracted declarations to disk once they exceed this many MiB (default 0, never)
+ *   - spill_dir: Directory for the spill file (default: the system temporary directory)
+ *   - print_info: Print the extracted declarations (default true)
+ *   - instrument: Wrap every binding in call counters and timers, read with <module>._cppglue_stats() (default false)
+ *   - pickle: Generate binary pickling for structs whose fields are all value types (default false)
+ *   - order_overloads: Register overloads cheapest to reject first, with noconvert() bool parameters where an integer
+ *     or floating point overload takes the numbers (default false, overloads are registered in declaration order)
+ *   - buffer_protocol: Expose classes with data() and size() or a public std::vector/std::array of numbers as their
+ *     only field through the buffer protocol (default false)
+ *   - [[buffers]]: Classes exposed through the buffer protocol with the members naming their memory: class, data
+ *     (pointer or container), size and shape (array of extents, outermost first), see BufferLayout
+ *   - zero_copy_strings: Functions taking std::string_view also accept bytes, bytearray, memoryview and other
+ *     contiguous buffers without copying them (default false)
+ *   - shard_bindings: Split the bindings into one source per namespace, compiled in parallel (default false)
+ *   - pipeline: Generate the sharded bindings while the sources are parsed (default false, implies shard_bindings),
+ *     keeps all declarations in memory
+ *   - [build]: Options of the generated CMakeLists.txt: precompile_headers (pybind11 and the bound user headers),
+ *     unity_batch_size (default 0, no unity build), hidden_visibility, thin_lto and gc_sections (all default false)
+ *   - [callbacks]: adapters (convert std::function with typed adapters instead of pybind11/functional.h) and queue
+ *     (implies adapters, void callbacks called from threads not holding the GIL are queued and run in batches)
+ *   - [async]: namespaces (qualified scopes) and functions (globs on qualified names) whose functions also get a
+ *     <name><suffix> variant returning an asyncio.Future, run on a thread pool owned by the module; threads sets
+ *     the pool size (default 0, the hardware concurrency) and suffix defaults to "_async"
+ *   - [export]: Optional IR export with path, format ("json" or "msgpack", default from the extension) and
+ *     only (skip binding generation)
+ *   - template_dir: Optional directory with customized build/packaging templates (same file names as src/templates)
+ *   - depfile: Optional Make/Ninja depfile to write, listing the config, the sources, every header they include and
+ *     the customized templates
+ *   - [filter]: Optional include/exclude rules applied while traversing the AST, see DeclarationFilterRules:
+ *     include_namespaces, exclude_namespaces, include_names, exclude_names (globs on qualified names),
+ *     include_regex, exclude_regex, include_headers, exclude_headers (globs on the defining file) and
+ *     access ("public" skips private and protected members, default "all")
+ * - `--serve <socket>`: Runs as a server listening on a unix socket, keeping clang's caches warm between requests.
+ * - `--connect <socket>`: Sends the config to a running server instead of running locally. If not given, the
+ *   environment variable PY_GEN_SERVER is used. Falls back to a local run if no server answers.
+ * - `--export <file>`, `--export-format <json|msgpack>`, `--export-only`: Overrides the [export] table.
+ * - `--memory-budget <MiB>`: Overrides memory_budget_mb.
+ * - `--shard <i>/<N>`: Extracts only shard i (0-based) of N of the sources and writes it to the export file,
+ *   no bindings are generated. Requires an export file.
+ * - `merge <files...>`: Subcommand reading the shard exports (or any IR exports) instead of parsing sources,
+ *   deduplicating declarations found by several shards and generating the modules of the config.
+ * - `--instrument`: Overrides instrument, generates instrumented bindings.
+ * - `--no-print`: Does not print the extracted declarations.
+ * - `--pipeline`: Overrides pipeline, generates the bindings while extracting.
+ * - `--depfile <file>`: Overrides depfile from the config.
+ * - `--template-dir <dir>`: Overrides template_dir from the config.
+ * - `--watch`: Keeps running and regenerates the outputs whenever a source or an included header changes.
+ * - `-h, --help`: Prints the usage information and exits.
+ *
+ * @param argc The number of command line arguments
+ * @param argv The array of command line arguments
+ * @param programOptions Structure to populate with parsed options
+ * @return true if parsing was successful, false otherwise
+ *
+ * Example usage:
+ * @code
+ * ./py-gen -c config.toml
+ * ./py-gen -c config.toml --shard 0/2 --export shard-0.msgpack & ./py-gen -c config.toml --shard 1/2 --export shard-1.msgpack
+ * ./py-gen merge -c config.toml shard-0.msgpack shard-1.msgpack
+ * @endcode
+ */
+bool processCLIargsIntoProgramOptions(int argc, const char **argv, ProgramOptions &programOptions);
+
+/**
+ * @brief Parses the TOML config file into the program options.
+ *
+ * @param configFile Path to the config file
+ * @param options Structure to populate with the config values
+ * @return The parsed table, or std::nullopt if the file is missing or invalid
+ */
+std::optional<toml::table> parseToml(const std::filesystem::path &configFile, ProgramOptions &options);
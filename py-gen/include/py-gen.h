@@ -1,8 +1,202 @@
+#pragma once
+
 #include "ast_actions.hpp"
 #include "include_tracker.hpp"
 #include "visitor.hpp"
 
 #include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Selects which files generateBindings writes to the output directory.
+ *
+ * All are written by default, incremental runs (watch mode) only select the outputs whose inputs changed.
+ */
+struct OutputSelection {
+    bool bindings{true};   // <moduleName>.cpp, depends on structs, functions and headers
+    bool buildFiles{true}; // CMakeLists.txt and CPM.cmake, depends on headers
+    bool package{true};    // setup.py, pyproject.toml and __init__.py, depends on the module name only
+    bool stub{true};       // <moduleName>.pyi, depends on structs and functions
+};
+
+/**
+ * @brief The contiguous memory of a class, exposed through the buffer protocol. Members are fields or member functions
+ * without parameters, given by their name.
+ */
+struct BufferLayout {
+    std::string              className; // Qualified name of the class
+    std::string              data;      // Pointer to the first element, or a contiguous container (std::vector, std::array)
+    std::string              size;      // Element count of one-dimensional buffers, default size() or the size of the container
+    std::vector<std::string> shape;     // Extents of multi-dimensional buffers, outermost first (row-major), replaces size
+};
+
+/**
+ * @brief Options changing the generated code, the defaults generate plain pybind11 bindings.
+ */
+struct GeneratorOptions {
+    // Wrap every binding in call counters and timers (cppglue_instrumentation.h), read with <module>._cppglue_stats()
+    bool instrument{false};
+
+    // Convert std::function parameters and fields with typed adapters (cppglue_callbacks.h) instead of pybind11/functional.h
+    bool callbackAdapters{false};
+
+    // With callbackAdapters: void callbacks called from threads not holding the GIL are queued and run in batches on a
+    // Python thread, see <module>._drain_callbacks()
+    bool queueCallbacks{false};
+
+    // Functions that also get a <name><asyncSuffix> variant returning an asyncio.Future, the call runs on a thread pool
+    // owned by the module (cppglue_async.h). Matched on the qualified name, nullptr generates no async variants
+    std::shared_ptr<const DeclarationFilter> asyncFunctions;
+    std::string                              asyncSuffix{"_async"};
+    size_t                                   asyncThreads{0}; // Pool size, 0 uses the hardware concurrency
+
+    // Binary __getstate__/__setstate__ (cppglue_pickle.h) for structs whose fields are all value types
+    bool pickle{false};
+
+    // Register the overloads of a name cheapest to reject first (bool, floating point, integers, strings, classes,
+    // containers) and bind bool parameters with noconvert() where an integer or floating point overload takes the numbers
+    bool orderOverloads{false};
+
+    // def_buffer (cppglue_buffer.h) for the classes in buffers and, with bufferProtocol, for classes detected as owning
+    // contiguous memory: a data() returning a pointer to numbers and an integer size(), or a public std::vector,
+    // std::array or array of numbers as their only field
+    bool                      bufferProtocol{false};
+    std::vector<BufferLayout> buffers;
+
+    // Functions taking std::string_view get an overload (cppglue_bytes.h) passing a view of bytes, bytearray, memoryview
+    // or any other contiguous buffer instead of a copy, unless their result may point into the arguments
+    bool zeroCopyStrings{false};
+
+    // Build options of the generated CMakeLists.txt (precompiled headers and unity builds need CMake 3.16):
+    bool   precompileHeaders{false}; // Precompile the pybind11 headers and the bound user headers
+    size_t unityBatchSize{0};        // Compile the binding sources in unity batches of this many files, 0 compiles each alone
+    bool   hiddenVisibility{false};  // Hidden visibility even if CMAKE_CXX_VISIBILITY_PRESET asks otherwise
+    bool   thinLto{false};           // ThinLTO instead of full LTO in Release builds (pybind11_add_module THIN_LTO)
+    bool   gcSections{false};        // Separate sections per function and data object, unreferenced ones are dropped when linking
+
+    // Split the bindings into one source per namespace (see BindingShard), rendered in parallel and compiled in parallel
+    bool shardBindings{false};
+};
+
+/**
+ * @brief The bindings of the declarations of one scope, generated as a source of their own (<moduleName>_<id>.cpp)
+ * defining cppglue_declare_<id>() and cppglue_define_<id>(), which <moduleName>.cpp calls.
+ *
+ * The declarations are given by their index, in the structs and functions the shard was partitioned from.
+ */
+struct BindingShard {
+    std::string           scope;       // Qualified name of the namespace or class, empty for the global namespace
+    std::string           id;          // The scope as an identifier, "global" for the global namespace
+    std::vector<size_t>   structs;     // Indices of the structs and enums declared in the scope
+    std::vector<size_t>   functions;   // Indices of the free functions of the scope and of the member functions of its classes
+    std::string           code;        // The rendered source, see renderShard
+    std::set<std::string> picklable;   // The structs whose fields code pickles
+    std::set<std::string> includes;    // The user headers code includes
+    bool                  dirty{true}; // Declarations were added since code was rendered
+};
+
+/**
+ * @brief Sorts declarations into BindingShards by their enclosing scope, in the order the scopes are first seen.
+ */
+class ShardPartition {
+  public:
+    /**
+     * @brief Adds the struct at index to the shard of its enclosing scope.
+     */
+    BindingShard &add(const StructInfo &structInfo, size_t index);
+
+    /**
+     * @brief Adds the function at index to the shard of its enclosing scope, member functions to the one of their class.
+     */
+    BindingShard &add(const FunctionInfo &funcInfo, size_t index);
+
+    [[nodiscard]] std::vector<BindingShard>       &shards() noexcept { return shards_; }
+    [[nodiscard]] const std::vector<BindingShard> &shards() const noexcept { return shards_; }
+
+    /**
+     * @brief Index of the struct or enum added with the qualified name, in any shard.
+     */
+    [[nodiscard]] std::optional<size_t> find(const std::string &qualifiedName) const;
+
+  private:
+    BindingShard &shardOf(const std::string &qualifiedName);
+
+    std::vector<BindingShard>               shards_;
+    std::unordered_map<std::string, size_t> scopes_;  // Scope to its shard
+    std::unordered_map<std::string, size_t> structs_; // Qualified name to the index of the struct
+    std::set<std::string>                   ids_;     // Taken ids, scopes with the same identifier get a numbered suffix
+};
+
+/**
+ * @brief Qualified names of the structs pickled with GeneratorOptions::pickle, empty without it.
+ */
+std::set<std::string> picklableStructs(const Structs &structs, const GeneratorOptions &options);
+
+/**
+ * @brief The arguments of cppglue::buffer::contiguous in the def_buffer of a class, expressions of its instance self.
+ */
+struct BufferExpressions {
+    std::string              data;    // Pointer to the first element
+    std::vector<std::string> extents; // Outermost first
+
+    bool operator==(const BufferExpressions &) const = default;
+};
+
+using Buffers = std::map<std::string, BufferExpressions>; // By qualified class name
+
+/**
+ * @brief The classes exposed through the buffer protocol, empty without GeneratorOptions::bufferProtocol and buffers.
+ */
+Buffers bufferClasses(const Structs &structs, const Functions &functions, const GeneratorOptions &options);
+
+/**
+ * @brief The functions bound under each qualified name, in extraction order.
+ */
+using OverloadGroups = std::map<std::string, std::vector<const FunctionInfo *>>;
+
+OverloadGroups overloadGroups(const Functions &functions);
+
+/**
+ * @brief The functions in the order they are bound, overloads ordered with GeneratorOptions::orderOverloads.
+ */
+std::vector<const FunctionInfo *> registrationOrder(const Functions &functions, const OverloadGroups &overloads,
+                                                    const GeneratorOptions &options);
+
+/**
+ * @brief Whether the parameter at index of the function is bound with noconvert().
+ */
+bool isNoConvert(const FunctionInfo &funcInfo, size_t index, const OverloadGroups &overloads, const GeneratorOptions &options);
+
+/**
+ * @brief Renders the code of a shard unless it is current: no declarations were added, the same structs are pickled
+ * and the same headers included.
+ *
+ * The shard includes only the user headers defining its declarations and the structs they refer to, and the pickled
+ * fields of its structs and of the structs they consist of.
+ *
+ * @param partition The shards, their indices refer to structs and functions
+ * @param index The shard to render
+ * @param headers Headers included by the sources, only direct includes are included by the shard
+ * @param picklable The picklable structs of the module, nullptr uses the ones among the structs of the shard alone,
+ * e.g. to render while the other scopes are not known yet
+ * @return Whether the code was rendered
+ */
+bool renderShard(ShardPartition &partition, size_t index, const Structs &structs, const Functions &functions, const Headers &headers,
+                 const std::set<std::string> *picklable, const std::string &moduleName, const GeneratorOptions &options);
+
+/**
+ * @brief renderShard for every shard, on as many threads as the hardware runs concurrently.
+ *
+ * @return How many shards were rendered, the others were current
+ */
+size_t renderShards(ShardPartition &partition, const Structs &structs, const Functions &functions, const Headers &headers,
+                    const std::set<std::string> &picklable, const std::string &moduleName, const GeneratorOptions &options);
 
 /**
  * @brief Generates Python bindings for C++ code
@@ -12,22 +206,47 @@
  * @param headers Collection of headers used by the code
  * @param moduleName Name of the Python module to generate
  * @param out Output stream to write the bindings to
+ * @param options Options changing the generated code
  */
 void generateBindings(const Structs &structs, const Functions &functions, const Headers &headers, const std::string &moduleName,
-                      std::ostream &out);
+                      std::ostream &out, const GeneratorOptions &options = {});
 
 /**
  * @brief Generates Python bindings for C++ code and writes to a directory
  *
  * Creates a new directory named <moduleName>_bindings containing:
  * - <moduleName>.cpp: The generated bindings code
- * - CMakeLists.txt: A CMake build configuration for the module
+ * - CMakeLists.txt: A CMake build configuration for the module, with the build options of GeneratorOptions
+ * - cppglue_instrumentation.h: Only with GeneratorOptions::instrument, included by <moduleName>.cpp
+ * - cppglue_callbacks.h: Only with GeneratorOptions::callbackAdapters and declarations taking or holding a std::function
+ * - cppglue_async.h: Only if GeneratorOptions::asyncFunctions selects at least one function
+ * - cppglue_pickle.h: Only with GeneratorOptions::pickle and at least one picklable struct
+ * - cppglue_buffer.h: Only if at least one class is exposed through the buffer protocol
+ * - cppglue_bytes.h: Only with GeneratorOptions::zeroCopyStrings and a function taking a std::string_view
+ *
+ * With GeneratorOptions::shardBindings the bindings are split by scope, see generateShardedBindings.
  *
  * @param structs Collection of struct/class definitions to generate bindings for
  * @param functions Collection of functions to generate bindings for
  * @param headers Collection of headers used by the code
  * @param moduleName Name of the Python module to generate
+ * @param outputDir Directory to write the files to
+ * @param outputs Which of the files to generate, unchanged files are never rewritten
+ * @param options Options changing the generated code
  * @throws std::runtime_error if file operations fail
  */
 void generateBindings(const Structs &structs, const Functions &functions, const Headers &headers, const std::string &moduleName,
-                      const std::filesystem::path &outputDir);
+                      const std::filesystem::path &outputDir, const OutputSelection &outputs = {}, const GeneratorOptions &options = {});
+
+/**
+ * @brief Writes the files of generateBindings with the bindings split into shards.
+ *
+ * <moduleName>.cpp only calls the functions of the shards, every shard is written to <moduleName>_<id>.cpp and added
+ * to the sources in CMakeLists.txt. The pybind11 and helper includes are shared in <moduleName>_bindings.h.
+ *
+ * @param structs The structs of the module, as for generateBindings
+ * @param shards The shards of structs and functions, rendered with the picklable structs of the module (renderShards)
+ */
+void generateShardedBindings(const Structs &structs, const Functions &functions, const Headers &headers, const std::string &moduleName,
+                             const std::filesystem::path &outputDir, const std::vector<BindingShard> &shards,
+                             const OutputSelection &outputs = {}, const GeneratorOptions &options = {});
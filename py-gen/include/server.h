@@ -0,0 +1,43 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+
+/**
+ * @brief Runs py-gen as a long lived server on a unix socket.
+ *
+ * Every request carries the command line and the working directory of the client, the server then runs the same
+ * extraction and generation as that command line would locally, command line overrides of the config included, but
+ * in one process. This keeps LLVM initialized and the file caches of the ExtractionSession warm between requests.
+ * Requests are handled one at a time.
+ *
+ * The request is line based, one argument per line, and terminated by an empty line:
+ * @code
+ * cwd /path/of/client
+ * arg -c
+ * arg config.toml
+ * arg --instrument
+ *
+ * @endcode
+ * Once the outputs are written it is answered with what the run printed and its exit code, after which the server
+ * closes the connection:
+ * @code
+ * stdout <bytes>
+ * <output>stderr <bytes>
+ * <output>exit <code>
+ * @endcode
+ *
+ * @param socketPath Path of the unix socket to listen on, an existing socket file is replaced
+ * @return non-zero if the socket could not be set up
+ */
+int runServer(const std::filesystem::path &socketPath);
+
+/**
+ * @brief Sends the command line to a running server, prints the output of the remote run and returns its exit code.
+ *
+ * @param socketPath Path of the unix socket the server listens on
+ * @param argc The number of command line arguments
+ * @param argv The command line arguments, run by the server as given
+ * @return The exit code of the remote run, or std::nullopt if no server could be reached (or an argument spans lines)
+ */
+std::optional<int> forwardToServer(const std::filesystem::path &socketPath, int argc, const char **argv);
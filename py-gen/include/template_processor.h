@@ -0,0 +1,160 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+enum class TemplateParameter { ModuleName, Version, HeaderFiles, ModuleOptions, BuildOptions };
+
+/**
+ * @brief Placeholder spelling of each TemplateParameter, other braces in a template (e.g. CMake's `${...}` or TOML
+ * inline tables) are left alone.
+ */
+inline constexpr std::array<std::string_view, 5> templateParameterNames = {"{module_name}", "{version}", "{header_files}",
+                                                                           "{module_options}", "{build_options}"};
+
+/**
+ * @brief Values substituted into a template, placeholders without a value are replaced by an empty string.
+ */
+struct TemplateArguments {
+    std::string_view moduleName{};
+    std::string_view version{};
+    std::string_view headerFiles{};
+    std::string_view moduleOptions{}; // Arguments of pybind11_add_module, each with a leading space
+    std::string_view buildOptions{};  // CMake commands configuring the module target
+
+    [[nodiscard]] constexpr std::string_view operator[](TemplateParameter parameter) const {
+        switch (parameter) {
+        case TemplateParameter::ModuleName:
+            return moduleName;
+        case TemplateParameter::Version:
+            return version;
+        case TemplateParameter::HeaderFiles:
+            return headerFiles;
+        case TemplateParameter::ModuleOptions:
+            return moduleOptions;
+        case TemplateParameter::BuildOptions:
+            return buildOptions;
+        }
+        return {};
+    }
+};
+
+/**
+ * @brief A placeholder in a template text.
+ */
+struct TemplateSlot {
+    size_t            offset{0};
+    size_t            length{0};
+    TemplateParameter parameter{TemplateParameter::ModuleName};
+};
+
+/**
+ * @brief Calls visit(TemplateSlot) for every placeholder in text, in order. Used at compile time for the embedded
+ * templates and at runtime for templates from the override directory.
+ */
+template <typename Visit> constexpr void forEachPlaceholder(std::string_view text, Visit &&visit) {
+    for (size_t pos = text.find('{'); pos != std::string_view::npos; pos = text.find('{', pos + 1)) {
+        for (size_t i = 0; i < templateParameterNames.size(); ++i) {
+            if (text.substr(pos).starts_with(templateParameterNames[i])) {
+                visit(TemplateSlot{
+                    .offset = pos, .length = templateParameterNames[i].size(), .parameter = static_cast<TemplateParameter>(i)});
+                pos += templateParameterNames[i].size() - 1;
+                break;
+            }
+        }
+    }
+}
+
+constexpr size_t countPlaceholders(std::string_view text) {
+    size_t count = 0;
+    forEachPlaceholder(text, [&count](const TemplateSlot &) { ++count; });
+    return count;
+}
+
+struct EmbeddedTemplate {
+    std::string_view name; // File name in src/templates
+    std::string_view text;
+};
+
+/**
+ * @brief The src/templates/ *.template files, compiled into the executable (see cmake/embed_templates.cmake).
+ */
+inline constexpr EmbeddedTemplate embeddedTemplates[] = {
+#include "embedded_templates.inc"
+};
+
+/**
+ * @brief Index of an embedded template, an unknown name is a compile error.
+ */
+consteval size_t templateIndex(std::string_view name) {
+    for (size_t i = 0; i < std::size(embeddedTemplates); ++i) {
+        if (embeddedTemplates[i].name == name) {
+            return i;
+        }
+    }
+    throw "Unknown template, is it missing from src/templates?";
+}
+
+template <size_t N> struct CompiledTemplate {
+    std::string_view            name;
+    std::string_view            text;
+    std::array<TemplateSlot, N> slots;
+};
+
+template <size_t Index> consteval auto compileTemplate() {
+    constexpr const EmbeddedTemplate &embedded = embeddedTemplates[Index];
+
+    CompiledTemplate<countPlaceholders(embedded.text)> compiled{.name = embedded.name, .text = embedded.text, .slots = {}};
+    size_t                                             slot = 0;
+    forEachPlaceholder(embedded.text, [&compiled, &slot](const TemplateSlot &placeholder) { compiled.slots[slot++] = placeholder; });
+    return compiled;
+}
+
+/**
+ * @brief Embedded template with the placeholder offsets computed at compile time.
+ */
+template <size_t Index> inline constexpr auto compiledTemplate = compileTemplate<Index>();
+
+/**
+ * @brief Renders the templates used for the generated build and packaging files.
+ *
+ * The embedded templates are rendered in a single pass, copying the text between the precomputed placeholder
+ * offsets and the argument values into one preallocated string. If an override directory is set and contains a
+ * file with the template's name, that file is used instead, its placeholders are found when it is read.
+ *
+ * @code
+ * auto cpm = TemplateProcessor::render<templateIndex("CPM.cmake.template")>({.version = "0.40.5"});
+ * @endcode
+ */
+class TemplateProcessor {
+  public:
+    template <size_t Index> static std::string render(const TemplateArguments &arguments) {
+        constexpr const auto &compiled = compiledTemplate<Index>;
+
+        if (auto text = readOverride(compiled.name)) {
+            return renderText(*text, arguments);
+        }
+        return splice(compiled.text, compiled.slots, arguments);
+    }
+
+    /**
+     * @brief Sets the directory searched for customized templates, an empty path uses the embedded ones only.
+     */
+    static void setOverrideDirectory(std::filesystem::path directory);
+
+    /**
+     * @brief Renders a template text whose placeholders are not known in advance.
+     */
+    static std::string renderText(std::string_view text, const TemplateArguments &arguments);
+
+  private:
+    static std::string splice(std::string_view text, std::span<const TemplateSlot> slots, const TemplateArguments &arguments);
+    static std::optional<std::string> readOverride(std::string_view name);
+
+    static inline std::filesystem::path overrideDirectory_;
+};
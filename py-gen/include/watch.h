@@ -0,0 +1,17 @@
+#pragma once
+
+#include "program_options.h"
+
+/**
+ * @brief Generates the bindings, then regenerates them whenever a source or one of its headers changes.
+ *
+ * Every source is extracted as its own translation unit and all files it includes (transitively, system headers
+ * excepted) are watched with inotify. On a change only the translation units depending on the changed files are
+ * re-extracted, after dropping the cached file system state (see ExtractionSession), and only the outputs whose inputs
+ * changed are regenerated. Unchanged outputs are never rewritten, so their modification times stay untouched and
+ * downstream builds do not recompile.
+ *
+ * @param options Options parsed from the command line and config file
+ * @return Only returns on error, with a non-zero exit code
+ */
+int runWatch(const ProgramOptions &options);
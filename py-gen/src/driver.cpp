@@ -0,0 +1,343 @@
+#include "driver.h"
+
+#include "file_writer.h"
+#include "ir_collector.hpp"
+#include "ir_export.hpp"
+#include "ir_import.hpp"
+#include "pipeline.h"
+#include "print_info.hpp"
+#include "py-gen.h"
+#include "template_processor.h"
+
+#include <algorithm>
+#include <clang/Tooling/JSONCompilationDatabase.h>
+#include <iterator>
+#include <llvm/Support/raw_ostream.h>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+ExtractionRequest makeExtractionRequest(const ProgramOptions &options) {
+    ExtractionRequest request{.sources = options.sources, .compileArgs = options.compileArgs};
+    request.filter         = options.filter;
+    request.instantiations = options.instantiations;
+    request.shardIndex = options.shardIndex;
+    request.shardCount = options.shardCount;
+    if (!options.compileCommandsFile.empty()) {
+        request.compileCommandsFile = std::filesystem::absolute(options.compileCommandsFile).string();
+    }
+    return request;
+}
+
+namespace {
+/**
+ * @brief The files a run read, written as a Make/Ninja depfile so the build reruns py-gen when any of them changes.
+ *
+ * Collects nothing unless the options name a depfile. Headers come from the IncludeTracker of every translation unit,
+ * transitive and system includes too, the rest (config, compile_commands.json, sources, customized templates) from
+ * the options.
+ */
+class Dependencies {
+  public:
+    /**
+     * @param parsesSources false for `py-gen merge`, the sources are dependencies of the shards, not of the merge
+     */
+    Dependencies(const ProgramOptions &options, bool parsesSources) : options_(options) {
+        if (options.depfile.empty()) {
+            return;
+        }
+        add(options.configFile);
+        if (parsesSources) {
+            addSources();
+        }
+        std::error_code ec;
+        if (!options.templateDir.empty() && std::filesystem::is_directory(options.templateDir, ec)) {
+            for (const auto &entry : std::filesystem::directory_iterator(options.templateDir, ec)) {
+                if (entry.path().extension() == ".template") {
+                    add(entry.path());
+                }
+            }
+        }
+    }
+
+    void add(const std::filesystem::path &path) {
+        if (!options_.depfile.empty() && !path.empty()) {
+            files_.insert(std::filesystem::absolute(path).lexically_normal().string());
+        }
+    }
+
+    void add(const Headers &headers) {
+        for (const auto &header : headers) {
+            add(header.fullPath);
+        }
+    }
+
+    /**
+     * @brief Writes the depfile, if the options name one, with target as its only target.
+     * @return false if it could not be written
+     */
+    bool write(const std::filesystem::path &target) const {
+        if (options_.depfile.empty()) {
+            return true;
+        }
+
+        std::string content = escape(std::filesystem::absolute(target).lexically_normal().string()) + ":";
+        for (const auto &file : files_) {
+            content += " \\\n  " + escape(file);
+        }
+        content += "\n";
+
+        try {
+            FileWriter::writeIfDifferent(options_.depfile, content);
+        } catch (const std::exception &e) {
+            llvm::errs() << "Failed to write the depfile " << options_.depfile.string() << ": " << e.what() << "\n";
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    void addSources() {
+        add(options_.compileCommandsFile);
+        for (const auto &source : options_.sources) {
+            add(source);
+        }
+        // Without sources in the config, extraction parses every file of the compilation database
+        if (options_.sources.empty() && !options_.compileCommandsFile.empty()) {
+            std::string error;
+            auto        database = clang::tooling::JSONCompilationDatabase::loadFromFile(
+                options_.compileCommandsFile.string(), error, clang::tooling::JSONCommandLineSyntax::AutoDetect);
+            if (database) {
+                for (const auto &source : database->getAllFiles()) {
+                    add(source);
+                }
+            }
+        }
+    }
+
+    // Make syntax, which Ninja reads as well
+    static std::string escape(const std::string &path) {
+        std::string escaped;
+        for (char c : path) {
+            if (c == ' ' || c == '#') {
+                escaped += '\\';
+            } else if (c == '$') {
+                escaped += '$';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    const ProgramOptions &options_;
+    std::set<std::string> files_;
+};
+
+/**
+ * @brief The depfile target: the bindings source of the first module, the export if no bindings are generated.
+ */
+std::filesystem::path depfileTarget(const ProgramOptions &options, bool generatesBindings) {
+    if (!generatesBindings || options.modules.empty()) {
+        return options.exportFile;
+    }
+    const auto &module = options.modules.front();
+    return std::filesystem::path(module.outputDir) / (module.moduleName + ".cpp");
+}
+
+/**
+ * @brief Generates every module of the config from the merged declarations.
+ */
+void generateModules(const ProgramOptions &options, const Structs &structs, const Functions &functions, const Headers &headers) {
+    TemplateProcessor::setOverrideDirectory(options.templateDir);
+
+    // All modules share the one extraction, each gets the declarations selected for it
+    for (const auto &module : options.modules) {
+        if (module.selector.selectsEverything()) {
+            generateBindings(structs, functions, headers, module.moduleName, module.outputDir, {}, options.generator);
+            continue;
+        }
+
+        auto [moduleStructs, moduleFunctions] = selectForModule(structs, functions, module.selector);
+        generateBindings(moduleStructs, moduleFunctions, headers, module.moduleName, module.outputDir, {}, options.generator);
+    }
+}
+} // namespace
+
+int runGenerator(const ProgramOptions &options, ExtractionSession &session) {
+    std::optional<ShardInfo> shard;
+    if (options.shardCount > 1) {
+        if (options.exportFile.empty()) {
+            llvm::errs() << "--shard needs an export file (--export or [export] path) to write the shard to\n";
+            return 1;
+        }
+        shard = ShardInfo{.index = options.shardIndex, .count = options.shardCount};
+    }
+
+    // Drops the copies of declarations from headers included by several sources, spills to disk beyond the budget
+    IRCollector collector({.memoryBudget = options.memoryBudget, .spillDirectory = options.spillDir});
+
+    // The export is written while extracting, each callback's declarations go straight to the file
+    std::optional<IRExporter> exporter;
+    if (!options.exportFile.empty()) {
+        auto format = irFormatFor(options.exportFormat, options.exportFile.string());
+        if (!format) {
+            llvm::errs() << "Unknown export format: " << options.exportFormat << " (use json or msgpack)\n";
+            return 1;
+        }
+        try {
+            exporter.emplace(options.exportFile.string(), *format, shard);
+        } catch (const std::exception &e) {
+            llvm::errs() << e.what() << "\n";
+            return 1;
+        }
+    }
+    // A shard is only a part of the declarations, the bindings are generated by `py-gen merge`
+    bool keepDeclarations = !(exporter && (options.exportOnly || shard));
+
+    // The pipeline takes over the export and the collection, its worker thread generates while clang parses
+    std::optional<BindingPipeline> pipeline;
+    if (options.pipeline && keepDeclarations) {
+        if (options.memoryBudget > 0) {
+            llvm::errs() << "The memory budget does not apply with pipeline, all declarations are kept in memory\n";
+        }
+        pipeline.emplace(options, exporter ? &*exporter : nullptr);
+    }
+
+    auto cb = [&](Structs &&structs_, Functions &&functions_) {
+        if (pipeline) {
+            pipeline->addDeclarations(std::move(structs_), std::move(functions_));
+            return;
+        }
+        if (exporter) {
+            exporter->addDeclarations(structs_, functions_);
+        }
+        if (keepDeclarations) {
+            collector.addDeclarations(std::move(structs_), std::move(functions_));
+        }
+    };
+
+    Dependencies dependencies(options, true);
+
+    auto hcb = [&](Headers &&headers_) {
+        dependencies.add(headers_);
+        if (pipeline) {
+            pipeline->addHeaders(std::move(headers_));
+            return;
+        }
+        if (exporter) {
+            exporter->addHeaders(headers_);
+        }
+        if (keepDeclarations) {
+            collector.addHeaders(std::move(headers_));
+        }
+    };
+
+    if (session.run(makeExtractionRequest(options), cb, hcb) != 0) {
+        llvm::errs() << "Error running tool\n";
+        return 1;
+    }
+
+    if (pipeline) {
+        try {
+            pipeline->finish();
+        } catch (const std::exception &e) {
+            llvm::errs() << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    if (exporter) {
+        exporter->finish();
+        llvm::outs() << "Exported declarations to: " << options.exportFile.string() << "\n";
+        if (!keepDeclarations) {
+            return dependencies.write(depfileTarget(options, false)) ? 0 : 1;
+        }
+    }
+
+    if (pipeline) {
+        pipeline->generate();
+        return dependencies.write(depfileTarget(options, true)) ? 0 : 1;
+    }
+
+    if (collector.spillCount() > 0) {
+        llvm::outs() << "Merging declarations spilled to disk " << collector.spillCount() << " times\n";
+    }
+    auto [structs, functions, headers] = collector.take();
+
+    if (options.printInfo) {
+        printInfo(structs, functions, headers);
+    }
+
+    generateModules(options, structs, functions, headers);
+    return dependencies.write(depfileTarget(options, true)) ? 0 : 1;
+}
+
+int runMerge(const ProgramOptions &options) {
+    // Check that the inputs are the complete set of shards of one extraction before reading any declarations
+    std::vector<std::pair<std::string, IRFileHeader>> inputs;
+    try {
+        for (const auto &path : options.mergeInputs) {
+            inputs.emplace_back(path, IRImporter::readHeader(path));
+        }
+    } catch (const std::exception &e) {
+        llvm::errs() << e.what() << "\n";
+        return 1;
+    }
+
+    bool sharded = std::any_of(inputs.begin(), inputs.end(), [](const auto &input) { return input.second.shard.has_value(); });
+    if (sharded) {
+        size_t            count = inputs.front().second.shard ? inputs.front().second.shard->count : 0;
+        std::vector<bool> found(count, false);
+        for (const auto &[path, header] : inputs) {
+            if (!header.shard || header.shard->count != count) {
+                llvm::errs() << path << " is not one of the " << count << " shards of " << inputs.front().first << "\n";
+                return 1;
+            }
+            if (found[header.shard->index]) {
+                llvm::errs() << path << ": shard " << header.shard->index << " was given twice\n";
+                return 1;
+            }
+            found[header.shard->index] = true;
+        }
+        if (auto missing = std::find(found.begin(), found.end(), false); missing != found.end()) {
+            llvm::errs() << "Shard " << std::distance(found.begin(), missing) << " of " << count << " is missing\n";
+            return 1;
+        }
+
+        // Shard order, so the output does not depend on the order of the arguments
+        std::sort(inputs.begin(), inputs.end(),
+                  [](const auto &lhs, const auto &rhs) { return lhs.second.shard->index < rhs.second.shard->index; });
+    }
+
+    // Headers are included by sources of several shards, the collector keeps the first copy of every declaration
+    IRCollector collector({.memoryBudget = options.memoryBudget, .spillDirectory = options.spillDir});
+    try {
+        auto cb  = [&collector](Structs &&structs_, Functions &&functions_) {
+            collector.addDeclarations(std::move(structs_), std::move(functions_));
+        };
+        auto hcb = [&collector](Headers &&headers_) { collector.addHeaders(std::move(headers_)); };
+        for (const auto &input : inputs) {
+            IRImporter::read(input.first, cb, hcb);
+            llvm::outs() << "Merged: " << input.first << "\n";
+        }
+    } catch (const std::exception &e) {
+        llvm::errs() << e.what() << "\n";
+        return 1;
+    }
+
+    auto [structs, functions, headers] = collector.take();
+
+    if (options.printInfo) {
+        printInfo(structs, functions, headers);
+    }
+
+    generateModules(options, structs, functions, headers);
+
+    Dependencies dependencies(options, false);
+    for (const auto &input : inputs) {
+        dependencies.add(input.first);
+    }
+    return dependencies.write(depfileTarget(options, true)) ? 0 : 1;
+}
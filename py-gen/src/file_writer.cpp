@@ -0,0 +1,257 @@
+#include "file_writer.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+constexpr uint64_t fnvOffsetBasis = 14695981039346656037ULL;
+constexpr uint64_t fnvPrime       = 1099511628211ULL;
+constexpr auto     manifestName   = ".py-gen-manifest";
+
+uint64_t fnv1a(uint64_t hash, const char *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= fnvPrime;
+    }
+    return hash;
+}
+
+std::optional<HashManifest::Entry> statFile(const std::filesystem::path &file) {
+    std::error_code ec;
+    auto            size     = std::filesystem::file_size(file, ec);
+    auto            modified = std::filesystem::last_write_time(file, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    return HashManifest::Entry{
+        .hash = 0, .size = size, .modified = std::chrono::duration_cast<std::chrono::nanoseconds>(modified.time_since_epoch()).count()};
+}
+} // namespace
+
+HashManifest::HashManifest(std::filesystem::path directory) : directory_(std::move(directory)) {
+    std::ifstream file(directory_ / manifestName);
+    std::string   line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        Entry              entry;
+        std::string        name;
+        if (fields >> std::hex >> entry.hash >> std::dec >> entry.size >> entry.modified && std::getline(fields >> std::ws, name)) {
+            entries_[name] = entry;
+        }
+    }
+}
+
+std::optional<HashManifest::Entry> HashManifest::lookup(const std::filesystem::path &file) const {
+    auto it = entries_.find(key(file));
+    if (it == entries_.end()) {
+        return std::nullopt;
+    }
+
+    auto current = statFile(file);
+    if (!current || current->size != it->second.size || current->modified != it->second.modified) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void HashManifest::update(const std::filesystem::path &file, uint64_t hash) {
+    if (auto current = statFile(file)) {
+        current->hash       = hash;
+        entries_[key(file)] = *current;
+        dirty_              = true;
+    }
+}
+
+void HashManifest::save() const {
+    if (!dirty_) {
+        return;
+    }
+
+    auto path      = directory_ / manifestName;
+    auto temporary = directory_ / (std::string(manifestName) + ".tmp");
+    {
+        std::ofstream out(temporary);
+        if (!out) {
+            throw std::runtime_error("Failed to open file for writing: " + temporary.string());
+        }
+        for (const auto &[name, entry] : entries_) {
+            out << std::hex << entry.hash << std::dec << ' ' << entry.size << ' ' << entry.modified << ' ' << name << '\n';
+        }
+    }
+    std::filesystem::rename(temporary, path);
+}
+
+std::string HashManifest::key(const std::filesystem::path &file) const {
+    auto relative = file.lexically_relative(directory_);
+    return relative.empty() ? file.generic_string() : relative.generic_string();
+}
+
+StreamingFileBuffer::StreamingFileBuffer(std::filesystem::path path, HashManifest *manifest)
+    : path_(std::move(path)), manifest_(manifest), hash_(fnvOffsetBasis) {
+    if (manifest_ != nullptr) {
+        previous_ = manifest_->lookup(path_);
+    }
+
+    std::error_code ec;
+    identical_ = std::filesystem::exists(path_, ec);
+
+    // Without a trusted hash the existing file is compared chunk by chunk, mapping it costs no extra memory
+    if (identical_ && !previous_) {
+        auto existing = llvm::MemoryBuffer::getFile(path_.string(), /*IsText=*/false, /*RequiresNullTerminator=*/false);
+        if (existing) {
+            existing_ = std::move(*existing);
+        } else {
+            identical_ = false;
+        }
+    }
+
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+StreamingFileBuffer::~StreamingFileBuffer() {
+    if (temporary_) {
+        temporary_->close();
+        temporary_.reset();
+        llvm::sys::fs::remove(temporaryPath_.string());
+    }
+}
+
+StreamingFileBuffer::int_type StreamingFileBuffer::overflow(int_type ch) {
+    flushChunk();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int StreamingFileBuffer::sync() {
+    flushChunk();
+    return 0;
+}
+
+void StreamingFileBuffer::openTemporary() {
+    int                    fd = -1;
+    llvm::SmallString<256> temporaryPath;
+    if (auto error = llvm::sys::fs::createUniqueFile(path_.string() + "-%%%%%%.tmp", fd, temporaryPath)) {
+        throw std::runtime_error("Failed to open file for writing: " + path_.string() + " (" + error.message() + ")");
+    }
+    temporaryPath_ = temporaryPath.str().str();
+    temporary_     = std::make_unique<llvm::raw_fd_ostream>(fd, /*shouldClose=*/true, /*unbuffered=*/true);
+}
+
+void StreamingFileBuffer::flushChunk() {
+    auto size = static_cast<size_t>(pptr() - pbase());
+    if (size == 0) {
+        return;
+    }
+
+    hash_ = fnv1a(hash_, pbase(), size);
+
+    if (identical_ && existing_) {
+        auto existing = existing_->getBuffer();
+        if (written_ + size > existing.size() || std::memcmp(existing.data() + written_, pbase(), size) != 0) {
+            identical_ = false;
+        }
+    }
+
+    // Nothing is written while the output matches the mapped file, on the first difference the matching prefix is copied
+    if (!identical_ || !existing_) {
+        if (!temporary_) {
+            openTemporary();
+            if (existing_ && written_ > 0) {
+                temporary_->write(existing_->getBufferStart(), written_);
+            }
+            existing_.reset();
+        }
+        temporary_->write(pbase(), size);
+    }
+
+    written_ += size;
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+bool StreamingFileBuffer::commit() {
+    flushChunk();
+    committed_ = true;
+
+    bool unchanged = previous_ ? identical_ && previous_->hash == hash_ && previous_->size == written_
+                               : identical_ && existing_ && existing_->getBufferSize() == written_;
+
+    if (unchanged) {
+        if (temporary_) {
+            temporary_->close();
+            temporary_.reset();
+            llvm::sys::fs::remove(temporaryPath_.string());
+        }
+        existing_.reset();
+        // Remember the hash, the next run can then skip reading the file
+        if (manifest_ != nullptr && !previous_) {
+            manifest_->update(path_, hash_);
+        }
+        return false;
+    }
+
+    // The output may be a strict prefix of the existing file, then nothing was written yet
+    if (!temporary_) {
+        openTemporary();
+        if (existing_ && written_ > 0) {
+            temporary_->write(existing_->getBufferStart(), written_);
+        }
+    }
+    existing_.reset();
+    temporary_->close();
+    bool failed = temporary_->has_error();
+    temporary_->clear_error();
+    temporary_.reset();
+
+    if (failed || llvm::sys::fs::rename(temporaryPath_.string(), path_.string())) {
+        llvm::sys::fs::remove(temporaryPath_.string());
+        throw std::runtime_error("Failed to write file: " + path_.string());
+    }
+
+    if (manifest_ != nullptr) {
+        manifest_->update(path_, hash_);
+    }
+    return true;
+}
+
+StreamingFile::StreamingFile(const std::filesystem::path &path, HashManifest *manifest) : std::ostream(nullptr), buffer_(path, manifest) {
+    rdbuf(&buffer_);
+}
+
+bool StreamingFile::commit() {
+    flush();
+    return buffer_.commit();
+}
+
+void FileWriter::writeIfDifferent(const std::filesystem::path &path, const std::string &content, HashManifest *manifest) {
+    StreamingFile file(path, manifest);
+    file << content;
+    commit(file, path);
+}
+
+void FileWriter::commit(StreamingFile &file, const std::filesystem::path &path) {
+    if (file.commit()) {
+        std::cout << "Generated: " << path << '\n';
+    } else {
+        std::cout << "Skipped unchanged file: " << path << '\n';
+    }
+}
+
+void FileWriter::ensureDirectory(const std::filesystem::path &path) {
+    if (!std::filesystem::exists(path)) {
+        if (!std::filesystem::create_directories(path)) {
+            throw std::runtime_error("Failed to create directory: " + path.string());
+        }
+        std::cout << "Created directory: " << path << '\n';
+    }
+}
@@ -0,0 +1,25 @@
+#include "module_selector.h"
+
+#include <set>
+
+std::pair<Structs, Functions> selectForModule(const Structs &structs, const Functions &functions, const ModuleSelector &selector) {
+    Structs               selectedStructs;
+    std::set<std::string> selectedParents;
+    for (const auto &structInfo : structs) {
+        if (selector.selects(structInfo.name.qualified, structInfo.definingFile)) {
+            selectedStructs.push_back(structInfo);
+            selectedParents.insert(structInfo.name.qualified);
+        }
+    }
+
+    Functions selectedFunctions;
+    for (const auto &funcInfo : functions) {
+        bool selected = funcInfo.parent.has_value() ? selectedParents.contains(funcInfo.parent->qualified)
+                                                    : selector.selects(funcInfo.name.qualified, funcInfo.definingFile);
+        if (selected) {
+            selectedFunctions.push_back(funcInfo);
+        }
+    }
+
+    return {std::move(selectedStructs), std::move(selectedFunctions)};
+}
@@ -0,0 +1,206 @@
+#include "pipeline.h"
+
+#include "ir_collector.hpp"
+#include "print_info.hpp"
+#include "template_processor.h"
+
+#include <algorithm>
+#include <llvm/Support/raw_ostream.h>
+#include <utility>
+
+BindingPipeline::BindingPipeline(const ProgramOptions &options, IRExporter *exporter)
+    : options_(options), generator_(options.generator), exporter_(exporter) {
+    generator_.shardBindings = true;
+    for (const auto &module : options.modules) {
+        modules_.emplace_back().config = &module;
+    }
+    worker_ = std::thread([this] { run(); });
+}
+
+BindingPipeline::~BindingPipeline() {
+    if (worker_.joinable()) {
+        {
+            std::lock_guard lock(mutex_);
+            finishing_ = true;
+        }
+        queued_.notify_one();
+        worker_.join();
+    }
+}
+
+void BindingPipeline::addDeclarations(Structs &&structs, Functions &&functions) {
+    {
+        std::lock_guard lock(mutex_);
+        queue_.push_back(Batch{.structs = std::move(structs), .functions = std::move(functions), .headers = std::nullopt});
+    }
+    queued_.notify_one();
+}
+
+void BindingPipeline::addHeaders(Headers &&headers) {
+    {
+        std::lock_guard lock(mutex_);
+        queue_.push_back(Batch{.structs = {}, .functions = {}, .headers = std::move(headers)});
+    }
+    queued_.notify_one();
+}
+
+void BindingPipeline::finish() {
+    {
+        std::lock_guard lock(mutex_);
+        finishing_ = true;
+    }
+    queued_.notify_one();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+    if (error_) {
+        std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+}
+
+void BindingPipeline::run() {
+    try {
+        while (true) {
+            std::unique_lock lock(mutex_);
+            // While clang parses the next source, render the shards that changed, one at a time so a queued
+            // translation unit is not kept waiting for all of them
+            if (queue_.empty() && !finishing_) {
+                lock.unlock();
+                if (renderNext()) {
+                    continue;
+                }
+                lock.lock();
+            }
+            queued_.wait(lock, [this] { return !queue_.empty() || finishing_; });
+            if (queue_.empty()) {
+                return;
+            }
+            auto batch = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+
+            process(batch);
+        }
+    } catch (...) {
+        error_ = std::current_exception();
+    }
+}
+
+void BindingPipeline::process(Batch &batch) {
+    if (batch.headers) {
+        if (exporter_ != nullptr) {
+            exporter_->addHeaders(*batch.headers);
+        }
+        for (auto &header : *batch.headers) {
+            if (seen_.insert(declarationKey(header)).second) {
+                headers_.push_back(std::move(header));
+            }
+        }
+        return;
+    }
+
+    if (exporter_ != nullptr) {
+        exporter_->addDeclarations(batch.structs, batch.functions);
+    }
+
+    // Headers are included by many sources, only the first copy of a declaration is kept
+    auto firstStruct   = structs_.size();
+    auto firstFunction = functions_.size();
+    for (auto &info : batch.structs) {
+        if (seen_.insert(declarationKey(info)).second) {
+            structs_.push_back(std::move(info));
+        }
+    }
+    for (auto &function : batch.functions) {
+        if (seen_.insert(declarationKey(function)).second) {
+            functions_.push_back(std::move(function));
+        }
+    }
+
+    for (auto &module : modules_) {
+        const auto &selector = module.config->selector;
+        for (auto i = firstStruct; i < structs_.size(); ++i) {
+            const auto &info = structs_[i];
+            if (selector.selectsEverything() || selector.selects(info.name.qualified, info.definingFile)) {
+                module.structs.push_back(i);
+                module.parents.insert(info.name.qualified);
+                module.partition.add(info, i);
+            }
+        }
+        for (auto i = firstFunction; i < functions_.size(); ++i) {
+            select(module, i);
+        }
+    }
+}
+
+void BindingPipeline::select(Module &module, size_t function) {
+    const auto &funcInfo = functions_[function];
+    const auto &selector = module.config->selector;
+
+    // Member functions follow their class, as in selectForModule
+    bool selected = selector.selectsEverything() ||
+                    (funcInfo.parent.has_value() ? module.parents.contains(funcInfo.parent->qualified)
+                                                 : selector.selects(funcInfo.name.qualified, funcInfo.definingFile));
+    if (selected) {
+        module.functions.push_back(function);
+        module.partition.add(funcInfo, function);
+    } else if (funcInfo.parent.has_value()) {
+        module.orphans.push_back(function);
+    }
+}
+
+bool BindingPipeline::renderNext() {
+    for (auto &module : modules_) {
+        auto &shards = module.partition.shards();
+        for (size_t i = 0; i < shards.size(); ++i) {
+            if (shards[i].dirty) {
+                // Picklable as far as the shard itself tells, with the headers seen so far, generate() corrects both
+                renderShard(module.partition, i, structs_, functions_, headers_, nullptr, module.config->moduleName, generator_);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void BindingPipeline::generate() {
+    TemplateProcessor::setOverrideDirectory(options_.templateDir);
+
+    if (options_.printInfo) {
+        printInfo(structs_, functions_, headers_);
+    }
+
+    for (auto &module : modules_) {
+        // Member functions extracted before their class, not expected from one translation unit but kept the same
+        for (auto index : std::exchange(module.orphans, {})) {
+            if (module.parents.contains(functions_[index].parent->qualified)) {
+                module.functions.push_back(index);
+                module.partition.add(functions_[index], index);
+            }
+        }
+        std::sort(module.functions.begin(), module.functions.end());
+
+        Structs   moduleStructs;
+        Functions moduleFunctions;
+        bool      everything = module.config->selector.selectsEverything();
+        if (!everything) {
+            for (auto index : module.structs) {
+                moduleStructs.push_back(structs_[index]);
+            }
+            for (auto index : module.functions) {
+                moduleFunctions.push_back(functions_[index]);
+            }
+        }
+        const auto &structs   = everything ? structs_ : moduleStructs;
+        const auto &functions = everything ? functions_ : moduleFunctions;
+
+        auto &shards   = module.partition.shards();
+        auto  rendered = renderShards(module.partition, structs_, functions_, headers_, picklableStructs(structs, generator_),
+                                      module.config->moduleName, generator_);
+        llvm::outs() << module.config->moduleName << ": " << shards.size() - rendered << " of " << shards.size()
+                     << " binding shards rendered during extraction\n";
+
+        generateShardedBindings(structs, functions, headers_, module.config->moduleName, module.config->outputDir, shards, {},
+                                generator_);
+    }
+}
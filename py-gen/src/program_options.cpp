@@ -0,0 +1,372 @@
+#include "program_options.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cxxopts.hpp>
+#include <exception>
+#include <iostream>
+#include <llvm/Support/raw_ostream.h>
+#include <regex>
+#include <string_view>
+
+namespace {
+std::vector<std::string> stringArray(const toml::node_view<const toml::node> &node) {
+    std::vector<std::string> strings;
+    if (const auto *array = node.as_array()) {
+        for (const auto &element : *array) {
+            if (auto str = element.value<std::string>()) {
+                strings.push_back(*str);
+            }
+        }
+    }
+    return strings;
+}
+
+ModuleConfig parseModule(const toml::table &table) {
+    ModuleConfig module;
+    module.moduleName = table["module_name"].value_or(std::string(""));
+    module.outputDir  = table["output_dir"].value_or(std::string("."));
+
+    DeclarationFilterRules rules;
+    rules.includeNamespaces = stringArray(table["namespaces"]);
+    rules.includeHeaders    = stringArray(table["headers"]);
+    rules.includeRegexes    = stringArray(table["names"]);
+    if (!rules.includeNamespaces.empty() || !rules.includeHeaders.empty() || !rules.includeRegexes.empty()) {
+        module.selector.filter.emplace(rules);
+    }
+    return module;
+}
+
+std::shared_ptr<const DeclarationFilter> parseFilter(const toml::table &table) {
+    DeclarationFilterRules rules;
+    rules.includeNamespaces = stringArray(table["include_namespaces"]);
+    rules.excludeNamespaces = stringArray(table["exclude_namespaces"]);
+    rules.includeNames      = stringArray(table["include_names"]);
+    rules.excludeNames      = stringArray(table["exclude_names"]);
+    rules.includeRegexes    = stringArray(table["include_regex"]);
+    rules.excludeRegexes    = stringArray(table["exclude_regex"]);
+    rules.includeHeaders    = stringArray(table["include_headers"]);
+    rules.excludeHeaders    = stringArray(table["exclude_headers"]);
+    rules.publicOnly        = table["access"].value_or(std::string("all")) == "public";
+    return std::make_shared<const DeclarationFilter>(rules);
+}
+
+// Namespaces and function globs are both name globs, so a function matching either gets an awaitable variant
+std::shared_ptr<const DeclarationFilter> parseAsync(const toml::table &table) {
+    DeclarationFilterRules rules;
+    rules.includeNames = stringArray(table["functions"]);
+    for (const auto &scope : stringArray(table["namespaces"])) {
+        rules.includeNames.push_back(scope + "::**");
+    }
+    if (rules.includeNames.empty()) {
+        return nullptr;
+    }
+    return std::make_shared<const DeclarationFilter>(rules);
+}
+
+bool parseShard(std::string_view shard, ProgramOptions &options) {
+    auto separator = shard.find('/');
+    if (separator == std::string_view::npos) {
+        return false;
+    }
+
+    auto parse = [](std::string_view text, size_t &value) {
+        auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return ec == std::errc{} && end == text.data() + text.size();
+    };
+    return parse(shard.substr(0, separator), options.shardIndex) && parse(shard.substr(separator + 1), options.shardCount) &&
+           options.shardCount > 0 && options.shardIndex < options.shardCount;
+}
+} // namespace
+
+bool processCLIargsIntoProgramOptions(int argc, const char **argv, ProgramOptions &programOptions) {
+    cxxopts::Options options("py-gen", "Python binding generator for C++");
+
+    options.add_options()("c,config", "Config file", cxxopts::value<std::string>());
+    options.add_options()("serve", "Run as server listening on the given unix socket", cxxopts::value<std::string>());
+    options.add_options()("connect", "Forward the config to a py-gen server listening on the given unix socket",
+                          cxxopts::value<std::string>());
+    options.add_options()("export", "Write the extracted declarations to a JSON or MessagePack file", cxxopts::value<std::string>());
+    options.add_options()("export-format", "Format of the export, json or msgpack", cxxopts::value<std::string>());
+    options.add_options()("export-only", "Only export the declarations, do not generate bindings");
+    options.add_options()("memory-budget", "MiB of extracted declarations kept in memory before spilling to disk",
+                          cxxopts::value<size_t>());
+    options.add_options()("instrument", "Generate bindings that count calls and measure their time, see _cppglue_stats()");
+    options.add_options()("no-print", "Do not print the extracted declarations");
+    options.add_options()("pipeline", "Generate the bindings, split by namespace, while the sources are parsed");
+    options.add_options()("shard", "Extract only shard i of N (0-based) of the sources, given as i/N", cxxopts::value<std::string>());
+    options.add_options()("command", "Subcommand, merge", cxxopts::value<std::string>());
+    options.add_options()("inputs", "Input files of the subcommand", cxxopts::value<std::vector<std::string>>());
+    options.add_options()("template-dir", "Directory with customized *.template files", cxxopts::value<std::string>());
+    options.add_options()("depfile", "Write a Make/Ninja depfile listing the files the run read", cxxopts::value<std::string>());
+    options.add_options()("watch", "Regenerate whenever a source or an included header changes");
+    options.add_options()("h,help",
+                          "Use -c <file> to specify a .toml config file, containing sources, compile_args, module_name, output_dir");
+
+    // Allow unmatched arguments to be passed through to clang
+    options.allow_unrecognised_options();
+    options.parse_positional({"command", "inputs"});
+    options.positional_help("[merge <ir files...>]");
+
+    try {
+        auto result = options.parse(argc, argv);
+
+        if (result.count("help")) {
+            llvm::outs() << options.help() << "\n";
+            return false;
+        }
+
+        if (result.count("serve")) {
+            programOptions.serveSocket = result["serve"].as<std::string>();
+        }
+
+        programOptions.watch = result.count("watch") > 0;
+
+        if (result.count("command")) {
+            if (result["command"].as<std::string>() != "merge") {
+                llvm::errs() << "Unknown command: " << result["command"].as<std::string>() << "\n";
+                return false;
+            }
+            programOptions.merge = true;
+            if (result.count("inputs")) {
+                programOptions.mergeInputs = result["inputs"].as<std::vector<std::string>>();
+            }
+            if (programOptions.mergeInputs.empty()) {
+                llvm::errs() << "merge needs at least one IR file\n";
+                return false;
+            }
+        }
+
+        if (result.count("shard") && !parseShard(result["shard"].as<std::string>(), programOptions)) {
+            llvm::errs() << "Invalid shard, expected <index>/<count> with index < count: " << result["shard"].as<std::string>() << "\n";
+            return false;
+        }
+
+        if (result.count("export")) {
+            programOptions.exportFile = result["export"].as<std::string>();
+        }
+        if (result.count("export-format")) {
+            programOptions.exportFormat = result["export-format"].as<std::string>();
+        }
+        if (result.count("memory-budget")) {
+            programOptions.memoryBudget = result["memory-budget"].as<size_t>() * 1024 * 1024;
+        }
+        programOptions.exportOnly = result.count("export-only") > 0;
+        programOptions.printInfo  = result.count("no-print") == 0;
+        programOptions.pipeline   = result.count("pipeline") > 0;
+
+        programOptions.generator.instrument = result.count("instrument") > 0;
+
+        if (result.count("template-dir")) {
+            programOptions.templateDir = result["template-dir"].as<std::string>();
+        }
+        if (result.count("depfile")) {
+            programOptions.depfile = result["depfile"].as<std::string>();
+        }
+
+        if (result.count("connect")) {
+            programOptions.connectSocket = result["connect"].as<std::string>();
+        } else if (const char *socket = std::getenv("PY_GEN_SERVER"); socket != nullptr && programOptions.serveSocket.empty()) {
+            programOptions.connectSocket = socket;
+        }
+
+        if (result.count("config")) {
+            programOptions.configFile = result["config"].as<std::string>();
+            if (!std::filesystem::exists(programOptions.configFile)) {
+                llvm::errs() << "Config file does not exist: <" << programOptions.configFile << "> relative to working dir: <"
+                             << std::filesystem::current_path() << ">\n";
+                return false;
+            }
+        }
+        return true;
+    } catch (const std::exception &e) {
+        llvm::errs() << "Error parsing options: " << e.what() << "\n";
+        return false;
+    }
+}
+
+std::optional<toml::table> parseToml(const std::filesystem::path &configFile, ProgramOptions &options) {
+    llvm::outs() << "Parsing config file: " << configFile.filename().c_str() << "\n";
+
+    std::optional<toml::table> config = std::nullopt;
+    if (!std::filesystem::exists(configFile)) {
+        llvm::errs() << "Config file does not exist: <" << configFile << ">\n";
+        return config;
+    }
+
+    try {
+        config = toml::parse_file(configFile.c_str());
+
+        auto &table = *config;
+        if (table.contains("compile_commands")) {
+            auto path = table["compile_commands"]["path"].value<std::string_view>();
+            if (!std::filesystem::exists(*path)) {
+                llvm::errs() << "compile_commands.json file does not exist: <" << path << ">\n";
+                return std::nullopt;
+            }
+            llvm::outs() << "Using compile_commands.json: " << path << "\n";
+            options.compileCommandsFile = *path;
+        }
+
+        if (table.contains("sources")) {
+            auto sources = table["sources"].as_array();
+            llvm::outs() << "sources:\n";
+            for (const auto &source : *sources) {
+                if (auto str = source.as_string()) {
+                    std::cout << "  " << *str << "\n";
+                    options.sources.emplace_back(*str);
+                }
+            }
+        }
+
+        if (table.contains("compile_args")) {
+            auto commands = table["compile_args"].as_array();
+            llvm::outs() << "compile_args:\n";
+            for (const auto &cmd : *commands) {
+                if (auto str = cmd.as_string()) {
+                    std::cout << "  " << *str << "\n";
+                    options.compileArgs.emplace_back(*str);
+                }
+            }
+        }
+
+        options.moduleName = table["module_name"].value_or(std::string(""));
+        llvm::outs() << "Module name: " << options.moduleName << "\n";
+        options.outputDir = table["output_dir"].value_or(std::string("."));
+        llvm::outs() << "Output directory: " << options.outputDir << "\n";
+
+        if (auto templateDir = table["template_dir"].value<std::string>(); templateDir && options.templateDir.empty()) {
+            options.templateDir = *templateDir;
+            llvm::outs() << "Template directory: " << options.templateDir.string() << "\n";
+        }
+        if (auto depfile = table["depfile"].value<std::string>(); depfile && options.depfile.empty()) {
+            options.depfile = *depfile;
+        }
+
+        // Command line options take precedence over the config
+        if (const auto *exportTable = table["export"].as_table()) {
+            if (options.exportFile.empty()) {
+                options.exportFile = (*exportTable)["path"].value_or(std::string(""));
+            }
+            if (options.exportFormat.empty()) {
+                options.exportFormat = (*exportTable)["format"].value_or(std::string(""));
+            }
+            options.exportOnly = options.exportOnly || (*exportTable)["only"].value_or(false);
+            llvm::outs() << "Exporting declarations to: " << options.exportFile.string() << "\n";
+        }
+        options.printInfo = options.printInfo && table["print_info"].value_or(true);
+
+        options.generator.instrument = options.generator.instrument || table["instrument"].value_or(false);
+        if (options.generator.instrument) {
+            llvm::outs() << "Generating instrumented bindings\n";
+        }
+
+        options.generator.pickle = table["pickle"].value_or(false);
+        options.generator.orderOverloads = table["order_overloads"].value_or(false);
+        options.generator.bufferProtocol = table["buffer_protocol"].value_or(false);
+        options.generator.zeroCopyStrings = table["zero_copy_strings"].value_or(false);
+
+        options.pipeline                = options.pipeline || table["pipeline"].value_or(false);
+        options.generator.shardBindings = options.pipeline || table["shard_bindings"].value_or(false);
+        if (options.pipeline) {
+            llvm::outs() << "Generating bindings while extracting\n";
+        }
+
+        if (const auto *buffers = table["buffers"].as_array()) {
+            for (const auto &element : *buffers) {
+                const auto  *entry = element.as_table();
+                BufferLayout layout;
+                if (entry != nullptr) {
+                    layout.className = (*entry)["class"].value_or(std::string(""));
+                    layout.data      = (*entry)["data"].value_or(std::string(""));
+                    layout.size      = (*entry)["size"].value_or(std::string(""));
+                    if (const auto *shape = (*entry)["shape"].as_array()) {
+                        for (const auto &extent : *shape) {
+                            layout.shape.push_back(extent.value_or(std::string("")));
+                        }
+                    }
+                }
+                if (layout.className.empty() || layout.data.empty()) {
+                    llvm::errs() << "Buffers need a class and a data member, e.g. { class = \"alpha::Image\", data = \"pixels\" }\n";
+                    return std::nullopt;
+                }
+                llvm::outs() << "Buffer protocol: " << layout.className << "\n";
+                options.generator.buffers.push_back(std::move(layout));
+            }
+        }
+
+        if (const auto *build = table["build"].as_table()) {
+            auto batchSize                      = (*build)["unity_batch_size"].value_or(int64_t{0});
+            options.generator.precompileHeaders = (*build)["precompile_headers"].value_or(false);
+            options.generator.unityBatchSize    = static_cast<size_t>(std::max<int64_t>(0, batchSize));
+            options.generator.hiddenVisibility  = (*build)["hidden_visibility"].value_or(false);
+            options.generator.thinLto           = (*build)["thin_lto"].value_or(false);
+            options.generator.gcSections        = (*build)["gc_sections"].value_or(false);
+        }
+
+        if (const auto *callbacks = table["callbacks"].as_table()) {
+            options.generator.queueCallbacks   = (*callbacks)["queue"].value_or(false);
+            options.generator.callbackAdapters = options.generator.queueCallbacks || (*callbacks)["adapters"].value_or(false);
+            if (options.generator.callbackAdapters) {
+                llvm::outs() << "Using typed callback adapters" << (options.generator.queueCallbacks ? ", queued from threads" : "") << "\n";
+            }
+        }
+
+        if (const auto *async = table["async"].as_table()) {
+            options.generator.asyncFunctions = parseAsync(*async);
+            options.generator.asyncSuffix    = (*async)["suffix"].value_or(std::string("_async"));
+            options.generator.asyncThreads   = static_cast<size_t>(std::max<int64_t>(0, (*async)["threads"].value_or(int64_t{0})));
+            llvm::outs() << "Generating awaitable " << options.generator.asyncSuffix << " variants\n";
+        }
+
+        if (auto budget = table["memory_budget_mb"].value<int64_t>(); budget && *budget > 0 && options.memoryBudget == 0) {
+            options.memoryBudget = static_cast<size_t>(*budget) * 1024 * 1024;
+            llvm::outs() << "Memory budget: " << *budget << " MiB\n";
+        }
+        options.spillDir = table["spill_dir"].value_or(std::string(""));
+
+        if (const auto *instantiations = table["instantiations"].as_array()) {
+            for (const auto &element : *instantiations) {
+                Instantiation instantiation;
+                if (auto type = element.value<std::string>()) {
+                    instantiation.type = *type;
+                } else if (const auto *entry = element.as_table()) {
+                    instantiation.type   = (*entry)["type"].value_or(std::string(""));
+                    instantiation.name   = (*entry)["name"].value_or(std::string(""));
+                    instantiation.header = (*entry)["header"].value_or(std::string(""));
+                }
+                if (instantiation.type.empty()) {
+                    llvm::errs() << "Instantiations need a type, e.g. \"Matrix<float>\"\n";
+                    return std::nullopt;
+                }
+                llvm::outs() << "Instantiation: " << instantiation.type << " as " << instantiation.pythonName() << "\n";
+                options.instantiations.push_back(std::move(instantiation));
+            }
+        }
+
+        if (const auto *filter = table["filter"].as_table()) {
+            options.filter = parseFilter(*filter);
+            llvm::outs() << "Using declaration filter\n";
+        }
+
+        if (const auto *modules = table["modules"].as_array()) {
+            for (const auto &module : *modules) {
+                if (const auto *moduleTable = module.as_table()) {
+                    options.modules.push_back(parseModule(*moduleTable));
+                    llvm::outs() << "Module: " << options.modules.back().moduleName << " -> " << options.modules.back().outputDir << "\n";
+                }
+            }
+        } else {
+            options.modules.push_back({.moduleName = options.moduleName, .outputDir = options.outputDir, .selector = {}});
+        }
+    } catch (const toml::parse_error &e) {
+        llvm::errs() << "toml parse error: " << e.what() << "\n";
+        config = std::nullopt;
+    } catch (const std::regex_error &e) {
+        llvm::errs() << "Invalid filter or module selection pattern: " << e.what() << "\n";
+        config = std::nullopt;
+    }
+
+    return config;
+}
@@ -1,124 +1,1024 @@
 #include "py-gen.h"
 
-#include <fstream>
+#include "file_writer.h"
+#include "template_processor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <functional>
+#include <sstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 
-void generateBindings(const Structs &structs, const Functions &functions, const Headers &headers, const std::string &moduleName,
-                      std::ostream &out) {
+namespace {
+/**
+ * @brief Whether any function parameter or field is a std::function, i.e. the callback adapters are needed.
+ */
+bool usesCallbacks(const Structs &structs, const Functions &functions) {
+    auto isFunction = [](const FieldDeclarationInfo &field) {
+        return field.isFunctional || field.type.qualified.find("std::function<") != std::string::npos;
+    };
+    for (const auto &structInfo : structs) {
+        if (!structInfo.isEnum && std::any_of(structInfo.members.begin(), structInfo.members.end(), isFunction)) {
+            return true;
+        }
+    }
+    for (const auto &funcInfo : functions) {
+        if (std::any_of(funcInfo.parameters.begin(), funcInfo.parameters.end(), isFunction)) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    // Write headers - TODO: be smart here, only include what is needed
-    out << "#include <pybind11/pybind11.h>\n"
-        << "#include <pybind11/stl.h>\n"
-        << "#include <pybind11/complex.h>\n"
-        << "#include <pybind11/functional.h>\n";
+/**
+ * @brief Qualified name of a function, for member functions including the class.
+ */
+std::string qualifiedName(const FunctionInfo &funcInfo) {
+    if (funcInfo.isMemberFunction && funcInfo.parent.has_value()) {
+        return funcInfo.parent->qualified + "::" + funcInfo.name.plain;
+    }
+    return funcInfo.name.qualified.empty() ? funcInfo.name.plain : funcInfo.name.qualified;
+}
 
-    // Extract all unique headers
-    std::set<std::string> userHeaders;
-    std::set<std::string> systemHeaders;
-    for (const auto &header : headers) {
-        if (!header.isSystem) {
-            userHeaders.insert(header.name);
+/**
+ * @brief Whether the parameter is an lvalue reference to a non-const type, which the function may write a result to.
+ */
+bool isMutableReference(const FieldDeclarationInfo &parameter) {
+    if (parameter.typeIndex == noType) {
+        std::string_view type = parameter.type.qualified;
+        return type.ends_with("&") && !type.ends_with("&&") && !type.starts_with("const ");
+    }
+    const auto &type = TypeTable::shared()[parameter.typeIndex];
+    return type.kind == TypeInfo::Kind::LValueReference && !TypeTable::shared()[type.element].isConst;
+}
+
+/**
+ * @brief Whether the result is a pointer or reference, the object it refers to is not owned by the result.
+ */
+bool returnsIndirection(const FunctionInfo &funcInfo) {
+    if (funcInfo.returnTypeIndex == noType) {
+        std::string_view type = funcInfo.returnType.qualified;
+        return type.ends_with("*") || type.ends_with("&");
+    }
+    auto kind = TypeTable::shared()[funcInfo.returnTypeIndex].kind;
+    return kind == TypeInfo::Kind::Pointer || kind == TypeInfo::Kind::LValueReference || kind == TypeInfo::Kind::RValueReference;
+}
+
+/**
+ * @brief Whether the function also gets an awaitable variant, static member functions never do.
+ *
+ * The call runs on copies of the arguments, so functions writing to non-const lvalue reference parameters are left
+ * out, as are functions returning pointers or references: nothing would keep the object referred to alive once the
+ * future is done, and converting it by value would move from the original.
+ */
+bool isAsync(const FunctionInfo &funcInfo, const GeneratorOptions &options) {
+    return options.asyncFunctions && !funcInfo.isStatic && !returnsIndirection(funcInfo) &&
+           std::none_of(funcInfo.parameters.begin(), funcInfo.parameters.end(), isMutableReference) &&
+           options.asyncFunctions->accepts(qualifiedName(funcInfo), funcInfo.definingFile);
+}
+
+bool usesAsync(const Functions &functions, const GeneratorOptions &options) {
+    return std::any_of(functions.begin(), functions.end(), [&options](const FunctionInfo &funcInfo) { return isAsync(funcInfo, options); });
+}
+
+bool isRvalueReference(const FieldDeclarationInfo &parameter) { return parameter.type.qualified.ends_with("&&"); }
+
+/**
+ * @brief Whether the parameter is a std::string_view, by value or by reference, which can view Python-owned bytes.
+ */
+bool isStringView(const FieldDeclarationInfo &parameter) {
+    if (parameter.typeIndex == noType) {
+        return false;
+    }
+    const auto *type = &TypeTable::shared()[parameter.typeIndex];
+    if (type->kind == TypeInfo::Kind::LValueReference || type->kind == TypeInfo::Kind::RValueReference) {
+        type = &TypeTable::shared()[type->element];
+    }
+    return type->kind == TypeInfo::Kind::Record && type->name == "std::basic_string_view" && !type->arguments.empty() &&
+           TypeTable::shared()[type->arguments.front()].spelling == "char";
+}
+
+/**
+ * @brief Whether the function gets an overload viewing buffers as its std::string_view parameters, see
+ * GeneratorOptions::zeroCopyStrings. Results that may point into the arguments (views, pointers and references) are
+ * left out, the buffers are released when the call returns. Static member functions are left out as well.
+ */
+bool takesBytes(const FunctionInfo &funcInfo, const GeneratorOptions &options) {
+    if (!options.zeroCopyStrings || (funcInfo.isMemberFunction && funcInfo.isStatic) || funcInfo.returnTypeIndex == noType ||
+        std::none_of(funcInfo.parameters.begin(), funcInfo.parameters.end(), isStringView)) {
+        return false;
+    }
+    const auto &result = TypeTable::shared()[funcInfo.returnTypeIndex];
+    bool        view   = result.kind == TypeInfo::Kind::Record && result.name == "std::basic_string_view";
+    return !view && result.kind != TypeInfo::Kind::Pointer && result.kind != TypeInfo::Kind::LValueReference &&
+           result.kind != TypeInfo::Kind::RValueReference;
+}
+
+bool usesBytes(const Functions &functions, const GeneratorOptions &options) {
+    return std::any_of(functions.begin(), functions.end(),
+                       [&options](const FunctionInfo &funcInfo) { return takesBytes(funcInfo, options); });
+}
+
+/**
+ * @brief The py::init overloads of a class besides the default constructor, each starting on a new line.
+ *
+ * Constructors taking rvalue references are bound through a factory owning the converted arguments and moving them
+ * into the constructor, aggregates (without constructors of their own) through brace initialization from all fields.
+ */
+std::string constructorBindings(const StructInfo &structInfo, const std::string &fullName) {
+    // Keywords only if every parameter has a name, pybind11 wants all or none
+    auto keywords = [](const std::vector<FieldDeclarationInfo> &parameters) {
+        std::string names;
+        if (std::all_of(parameters.begin(), parameters.end(), [](const FieldDeclarationInfo &p) { return !p.name.plain.empty(); })) {
+            for (const auto &parameter : parameters) {
+                names += fmt::format(", py::arg(\"{}\")", parameter.name.plain);
+            }
+        }
+        return names;
+    };
+
+    std::string bindings;
+    for (const auto &constructor : structInfo.constructors) {
+        const auto &parameters = constructor.parameters;
+        std::string declarations;
+        std::string arguments;
+        for (size_t i = 0; i < parameters.size(); ++i) {
+            const auto &type      = parameters[i].type.qualified;
+            auto        separator = i == 0 ? "" : ", ";
+            if (isRvalueReference(parameters[i])) {
+                declarations += fmt::format("{}std::remove_reference_t<{}> a{}", separator, type, i);
+                arguments += fmt::format("{}std::move(a{})", separator, i);
+            } else {
+                declarations += fmt::format("{}{} a{}", separator, type, i);
+                arguments += fmt::format("{}a{}", separator, i);
+            }
+        }
+
+        if (std::any_of(parameters.begin(), parameters.end(), isRvalueReference)) {
+            bindings += fmt::format("\n        .def(py::init([]({}) {{ return new {}({}); }}){})", declarations, fullName, arguments,
+                                    keywords(parameters));
         } else {
-            systemHeaders.insert(header.name);
+            std::string types;
+            for (const auto &parameter : parameters) {
+                types += (types.empty() ? "" : ", ") + parameter.type.qualified;
+            }
+            bindings += fmt::format("\n        .def(py::init<{}>(){})", types, keywords(parameters));
         }
     }
 
-    // Write user and system headers
-    out << "\n// User headers" << (userHeaders.empty() ? " - [none found] \n" : "\n");
-    for (const auto &header : userHeaders) {
-        out << "#include \"" << header << "\"\n";
+    if (structInfo.isAggregate && structInfo.constructors.empty()) {
+        std::string declarations;
+        std::string arguments;
+        for (size_t i = 0; i < structInfo.members.size(); ++i) {
+            declarations += fmt::format("{}decltype({}::{}) a{}", i == 0 ? "" : ", ", fullName, structInfo.members[i].name.plain, i);
+            arguments += fmt::format("{}std::move(a{})", i == 0 ? "" : ", ", i);
+        }
+        bindings += fmt::format("\n        .def(py::init([]({}) {{ return new {}{{{}}}; }}){})", declarations, fullName, arguments,
+                                keywords(structInfo.members));
     }
+    return bindings;
+}
 
-    out << "\n// System headers" << (systemHeaders.empty() ? " - [none found] \n" : "\n");
-    for (const auto &header : systemHeaders) {
-        out << "// #include <" << header << ">\n";
+/**
+ * @brief A canonical type spelling without tag keywords, standard library inline namespaces and template spacing.
+ */
+std::string normalizeType(std::string type) {
+    for (std::string_view noise : {"struct ", "class ", "__cxx11::", "__1::"}) {
+        for (auto pos = type.find(noise); pos != std::string::npos; pos = type.find(noise, pos)) {
+            type.erase(pos, noise.size());
+        }
     }
+    std::string normalized;
+    for (size_t i = 0; i < type.size(); ++i) {
+        bool spaceBeforeClose = type[i] == ' ' && i + 1 < type.size() && type[i + 1] == '>';
+        bool spaceAfterComma  = type[i] == ' ' && i > 0 && type[i - 1] == ',';
+        if (!spaceBeforeClose && !spaceAfterComma) {
+            normalized += type[i];
+        }
+    }
+    return normalized;
+}
 
-    out << "\nnamespace py = pybind11;\n\n";
-    out << "PYBIND11_MODULE(" << moduleName << ", m) {\n";
+/**
+ * @brief Whether a normalized type can be packed by cppglue_pickle.h, structs only if they are in picklable. The
+ * picklable structs the type consists of are added to structs, if given.
+ * @note Only for IR without interned types, the canonical spelling of bool is "_Bool" there.
+ */
+bool isPicklableType(std::string_view type, const std::set<std::string> &picklable, std::vector<std::string> *structs = nullptr) {
+    static const std::set<std::string_view> arithmetic{
+        "bool", "_Bool", "char", "signed char", "unsigned char", "wchar_t", "char8_t", "char16_t", "char32_t", "short", "unsigned short",
+        "int", "unsigned int", "long", "unsigned long", "long long", "unsigned long long", "float", "double", "long double"};
+    if (arithmetic.contains(type) || type.starts_with("enum ") || type.starts_with("std::complex<") || type == "std::string" ||
+        type == "std::basic_string<char>" || type == "std::basic_string<char,std::char_traits<char>,std::allocator<char>>") {
+        return true;
+    }
+    if (type.starts_with("std::vector<") && type.ends_with(">")) {
+        auto arguments = type.substr(12, type.size() - 13);
+        // The element type ends at the first top level comma, the allocator has to be the default one
+        int  depth     = 0;
+        auto end       = arguments.size();
+        for (size_t i = 0; i < arguments.size() && end == arguments.size(); ++i) {
+            depth += arguments[i] == '<' ? 1 : arguments[i] == '>' ? -1 : 0;
+            if (arguments[i] == ',' && depth == 0) {
+                end = i;
+            }
+        }
+        auto element = arguments.substr(0, end);
+        return (end == arguments.size() || arguments.substr(end + 1).starts_with("std::allocator<")) &&
+               isPicklableType(element, picklable, structs);
+    }
+    if (!picklable.contains(std::string(type))) {
+        return false;
+    }
+    if (structs != nullptr) {
+        structs->emplace_back(type);
+    }
+    return true;
+}
 
-    // Helper function to get fully qualified name
-    auto getFullName = [](const StructInfo &s) { return s.name.qualified.empty() ? s.name.plain : s.name.qualified; };
+/**
+ * @brief Whether an interned type can be packed by cppglue_pickle.h, decided from its kind and template arguments
+ * instead of its spelling, see the overload above for the rest.
+ */
+bool isPicklableType(TypeIndex index, const std::set<std::string> &picklable, std::vector<std::string> *structs = nullptr) {
+    const auto &type = TypeTable::shared()[index];
+    if (type.isConst || type.isVolatile) {
+        return false;
+    }
+    switch (type.kind) {
+    case TypeInfo::Kind::Bool:
+    case TypeInfo::Kind::Integer:
+    case TypeInfo::Kind::Floating:
+    case TypeInfo::Kind::Enum:
+        return true;
+    case TypeInfo::Kind::Record:
+        break;
+    default:
+        return false;
+    }
 
-    // First, declare all enums and classes
+    auto isDefault = [&](size_t argument, std::string_view name) {
+        return argument >= type.arguments.size() || TypeTable::shared()[type.arguments[argument]].name == name;
+    };
+    if (type.name == "std::complex") {
+        return true;
+    }
+    if (type.name == "std::basic_string") {
+        return !type.arguments.empty() && TypeTable::shared()[type.arguments.front()].spelling == "char" &&
+               isDefault(1, "std::char_traits") && isDefault(2, "std::allocator");
+    }
+    if (type.name == "std::vector") {
+        return !type.arguments.empty() && isDefault(1, "std::allocator") && isPicklableType(type.arguments.front(), picklable, structs);
+    }
+
+    // Instantiations are extracted under the name with their arguments, e.g. "alpha::Matrix<float>"
+    for (const auto &name : {normalizeType(type.spelling), type.name}) {
+        if (picklable.contains(name)) {
+            if (structs != nullptr) {
+                structs->push_back(name);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isPicklableType(const FieldDeclarationInfo &field, const std::set<std::string> &picklable,
+                     std::vector<std::string> *structs = nullptr) {
+    if (field.typeIndex != noType) {
+        return isPicklableType(field.typeIndex, picklable, structs);
+    }
+    return isPicklableType(normalizeType(field.type.qualified), picklable, structs);
+}
+
+} // namespace
+
+/**
+ * @brief Qualified names of the structs that get binary pickling: all fields are arithmetic, enum, complex or string
+ * values, vectors of those or other picklable structs. The fields are the whole state, so structs without extracted
+ * fields, with inherited fields or with fields left out by the filter are not picklable, and neither are structs
+ * with fields that are not public.
+ */
+std::set<std::string> picklableStructs(const Structs &structs, const GeneratorOptions &options) {
+    std::set<std::string> picklable;
+    if (!options.pickle) {
+        return picklable;
+    }
     for (const auto &structInfo : structs) {
-        if (structInfo.isEnum) {
-            out << fmt::format("    py::enum_<{0}>(m, \"{1}\", py::arithmetic())\n", getFullName(structInfo), structInfo.name.plain);
-            for (const auto &member : structInfo.members) {
-                out << fmt::format("        .value(\"{0}\", {1}::{0})\n", member.name.plain, getFullName(structInfo));
+        bool complete = structInfo.hasAllFields && std::all_of(structInfo.members.begin(), structInfo.members.end(),
+                                                               [](const FieldDeclarationInfo &field) { return field.isPublic; });
+        if (!structInfo.isEnum && !structInfo.members.empty() && structInfo.isDefaultConstructible && complete) {
+            picklable.insert(structInfo.name.qualified.empty() ? structInfo.name.plain : structInfo.name.qualified);
+        }
+    }
+
+    // Drop the structs with a field that can not be packed until the rest only refers to picklable structs
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto &structInfo : structs) {
+            auto name = structInfo.name.qualified.empty() ? structInfo.name.plain : structInfo.name.qualified;
+            if (!picklable.contains(name)) {
+                continue;
             }
-            out << "        .export_values();\n\n";
-        } else {
-            out << fmt::format("    py::class_<{0}> {1}(m, \"{2}\");\n", getFullName(structInfo), structInfo.name.plain + "_class",
-                               structInfo.name.plain);
+            bool packable = std::all_of(structInfo.members.begin(), structInfo.members.end(), [&](const FieldDeclarationInfo &field) {
+                return !field.isSpecial() && isPicklableType(field, picklable);
+            });
+            if (!packable) {
+                picklable.erase(name);
+                changed = true;
+            }
+        }
+    }
+    return picklable;
+}
+
+namespace {
+/**
+ * @brief Whether the buffer protocol can describe the type as an element: arithmetic types and std::complex.
+ */
+bool isBufferElement(TypeIndex index) {
+    if (index == noType) {
+        return false;
+    }
+    const auto &type = TypeTable::shared()[index];
+    return type.kind == TypeInfo::Kind::Bool || type.kind == TypeInfo::Kind::Integer || type.kind == TypeInfo::Kind::Floating ||
+           (type.kind == TypeInfo::Kind::Record && type.name == "std::complex");
+}
+
+/**
+ * @brief Whether the type is a contiguous container of buffer elements: a std::vector (except of bool), std::array or array.
+ */
+bool isContiguousContainer(TypeIndex index) {
+    if (index == noType) {
+        return false;
+    }
+    const auto &type = TypeTable::shared()[index];
+    if (type.kind == TypeInfo::Kind::Array) {
+        return isBufferElement(type.element);
+    }
+    return type.kind == TypeInfo::Kind::Record && (type.name == "std::vector" || type.name == "std::array") && !type.arguments.empty() &&
+           isBufferElement(type.arguments.front()) && TypeTable::shared()[type.arguments.front()].kind != TypeInfo::Kind::Bool;
+}
+
+} // namespace
+
+/**
+ * @brief The def_buffer arguments of the classes exposed through the buffer protocol, see GeneratorOptions::buffers.
+ *
+ * The layouts of the config name members, a name that is not an extracted field is called as a member function. A
+ * layout naming a field that is not public is skipped, the bindings could not read it. Detection needs the interned
+ * types, IR exported without them only gets the configured layouts.
+ */
+Buffers bufferClasses(const Structs &structs, const Functions &functions, const GeneratorOptions &options) {
+    Buffers buffers;
+    if (!options.bufferProtocol && options.buffers.empty()) {
+        return buffers;
+    }
+
+    // Member functions without parameters by class and name
+    std::map<std::string, std::map<std::string, const FunctionInfo *>> getters;
+    for (const auto &funcInfo : functions) {
+        if (funcInfo.parent.has_value() && !funcInfo.isStatic && funcInfo.parameters.empty()) {
+            getters[funcInfo.parent->qualified].emplace(funcInfo.name.plain, &funcInfo);
         }
     }
 
-    // Then, define the actual bindings for non-enum classes
     for (const auto &structInfo : structs) {
         if (structInfo.isEnum) {
-            continue; // Already handled
+            continue;
         }
+        auto fullName = structInfo.name.qualified.empty() ? structInfo.name.plain : structInfo.name.qualified;
+        auto field    = [&structInfo](const std::string &name) -> const FieldDeclarationInfo * {
+            auto it = std::find_if(structInfo.members.begin(), structInfo.members.end(),
+                                   [&name](const FieldDeclarationInfo &member) { return member.name.plain == name; });
+            return it == structInfo.members.end() ? nullptr : &*it;
+        };
+        auto member = [&field](const std::string &name) { return "self." + name + (field(name) != nullptr ? "" : "()"); };
+
+        auto layout = std::find_if(options.buffers.begin(), options.buffers.end(),
+                                   [&fullName](const BufferLayout &buffer) { return buffer.className == fullName; });
+        if (layout != options.buffers.end()) {
+            auto names = layout->shape;
+            names.insert(names.end(), {layout->data, layout->size});
+            if (std::any_of(names.begin(), names.end(), [&field](const std::string &name) {
+                    const auto *member = name.empty() ? nullptr : field(name);
+                    return member != nullptr && !member->isPublic;
+                })) {
+                continue;
+            }
 
-        std::string className = structInfo.name.plain + "_class";
-        std::string fullName  = getFullName(structInfo);
+            // A container field is asked for its data and size, a pointer field or a function gives the pointer
+            const auto       *data      = field(layout->data);
+            bool              container = data != nullptr && !data->isPointer;
+            BufferExpressions expressions{.data = container ? "std::data(self." + layout->data + ")" : member(layout->data), .extents = {}};
+            for (const auto &extent : layout->shape) {
+                expressions.extents.push_back(member(extent));
+            }
+            if (expressions.extents.empty()) {
+                expressions.extents.push_back(!layout->size.empty() ? member(layout->size)
+                                              : container          ? "std::size(self." + layout->data + ")"
+                                                                   : member("size"));
+            }
+            buffers.emplace(fullName, std::move(expressions));
+            continue;
+        }
+        if (!options.bufferProtocol) {
+            continue;
+        }
 
-        // Main class definition
-        out << fmt::format("    {0}\n", className) << "        .def(py::init<>())\n";
+        // data() and size() like the standard containers
+        const auto &methods = getters[fullName];
+        auto        data    = methods.find("data");
+        auto        size    = methods.find("size");
+        if (data != methods.end() && size != methods.end() && data->second->returnTypeIndex != noType &&
+            size->second->returnTypeIndex != noType) {
+            const auto &pointer = TypeTable::shared()[data->second->returnTypeIndex];
+            if (pointer.kind == TypeInfo::Kind::Pointer && isBufferElement(pointer.element) &&
+                TypeTable::shared()[size->second->returnTypeIndex].kind == TypeInfo::Kind::Integer) {
+                buffers.emplace(fullName, BufferExpressions{.data = "self.data()", .extents = {"self.size()"}});
+                continue;
+            }
+        }
 
-        // Add members
-        for (const auto &member : structInfo.members) {
-            out << fmt::format("        .def_readwrite(\"{0}\", &{1}::{0})\n", member.name.plain, fullName);
+        // Nothing but a public container of numbers. Next to other fields the container may be just one part of the
+        // object (a name, an id), those layouts are configured in [[buffers]]
+        if (structInfo.members.size() == 1 && structInfo.hasAllFields) {
+            const auto &payload = structInfo.members.front();
+            if (payload.isPublic && !payload.isPointer && !payload.isReference && isContiguousContainer(payload.typeIndex)) {
+                buffers.emplace(fullName, BufferExpressions{.data    = "std::data(self." + payload.name.plain + ")",
+                                                            .extents = {"std::size(self." + payload.name.plain + ")"}});
+            }
         }
+    }
+    return buffers;
+}
 
-        // Add member functions
+namespace {
+/**
+ * @brief How cheaply pybind11 rejects a Python value of the wrong type for the parameter, lower is cheaper.
+ *
+ * 0 bool, 1 floating point, 2 integers and characters, 3 strings, 4 everything else (bound classes and enums) and 5
+ * containers and callables, which convert element by element before they can fail. Floating point ranks before the
+ * integers although both reject as cheaply: in the converting pass the integer caster takes any number through
+ * __int__, truncating e.g. numpy.float32 or Decimal, which the floating point overload has to see first.
+ *
+ * Ranked by the interned TypeInfo, parameters without one (IR exported before types were interned) by their spelling,
+ * where typedefs are only known for the fixed width and size integers.
+ */
+int dispatchRank(const FieldDeclarationInfo &parameter) {
+    if (parameter.typeIndex != noType) {
+        const auto *type = &TypeTable::shared()[parameter.typeIndex];
+        if (type->kind == TypeInfo::Kind::LValueReference || type->kind == TypeInfo::Kind::RValueReference) {
+            type = &TypeTable::shared()[type->element];
+        }
+
+        static const std::set<std::string_view> containers{"std::vector", "std::array", "std::list",  "std::deque",
+                                                           "std::map",    "std::unordered_map", "std::set", "std::unordered_set",
+                                                           "std::tuple",  "std::pair",  "std::function"};
+        switch (type->kind) {
+        case TypeInfo::Kind::Bool:
+            return 0;
+        case TypeInfo::Kind::Floating:
+            return 1;
+        case TypeInfo::Kind::Integer:
+            return 2;
+        case TypeInfo::Kind::Pointer:
+            return TypeTable::shared()[type->element].spelling.ends_with("char") ? 3 : 4; // C strings
+        case TypeInfo::Kind::Record:
+            if (type->name == "std::basic_string" || type->name == "std::basic_string_view") {
+                return 3;
+            }
+            return containers.contains(type->name) ? 5 : 4;
+        default:
+            return 4;
+        }
+    }
+
+    auto type = normalizeType(parameter.type.qualified);
+    if (type.starts_with("const ")) {
+        type.erase(0, 6);
+    }
+    while (!type.empty() && (type.back() == '&' || type.back() == ' ')) {
+        type.pop_back();
+    }
+    if (type.starts_with("::")) {
+        type.erase(0, 2);
+    }
+    if (type.starts_with("std::") && type.ends_with("_t") && type.find('<') == std::string::npos) {
+        type.erase(0, 5);
+    }
+
+    static const std::set<std::string_view> integral{
+        "char", "signed char", "unsigned char", "wchar_t", "char8_t", "char16_t", "char32_t", "short", "unsigned short", "int",
+        "unsigned int", "long", "unsigned long", "long long", "unsigned long long", "int8_t", "int16_t", "int32_t", "int64_t",
+        "uint8_t", "uint16_t", "uint32_t", "uint64_t", "size_t", "ptrdiff_t", "intptr_t", "uintptr_t", "ssize_t"};
+    if (type == "bool") {
+        return 0;
+    }
+    if (type == "float" || type == "double" || type == "long double") {
+        return 1;
+    }
+    if (integral.contains(type)) {
+        return 2;
+    }
+    if (type == "std::string" || type == "std::string_view" || type.starts_with("std::basic_string") || type == "char *") {
+        return 3;
+    }
+    for (std::string_view prefix : {"std::vector<", "std::array<", "std::list<", "std::deque<", "std::map<", "std::unordered_map<",
+                                    "std::set<", "std::unordered_set<", "std::tuple<", "std::pair<", "std::function<"}) {
+        if (type.starts_with(prefix)) {
+            return 5;
+        }
+    }
+    return 4;
+}
+} // namespace
+
+OverloadGroups overloadGroups(const Functions &functions) {
+    OverloadGroups groups;
+    for (const auto &funcInfo : functions) {
+        groups[qualifiedName(funcInfo)].push_back(&funcInfo);
+    }
+    return groups;
+}
+
+/**
+ * @brief The functions in the order they are bound.
+ *
+ * pybind11 tries the overloads of a name in registration order and pays for every rejected one, in its first pass
+ * without conversions. With orderOverloads the overloads are registered together, the cheapest to reject first: by
+ * their most expensive parameter, then parameter by parameter (so bool before float before int, see dispatchRank).
+ * Otherwise, and for all other functions, the extraction order is kept.
+ */
+std::vector<const FunctionInfo *> registrationOrder(const Functions &functions, const OverloadGroups &overloads,
+                                                    const GeneratorOptions &options) {
+    std::vector<const FunctionInfo *> ordered;
+    ordered.reserve(functions.size());
+    if (!options.orderOverloads) {
         for (const auto &funcInfo : functions) {
-            if (funcInfo.parent.has_value() && funcInfo.parent->qualified == fullName) {
-                // Build parameter documentation string
-                std::string params;
-                if (funcInfo.hasParameters()) {
-                    for (const auto &param : funcInfo.parameters) {
-                        if (!params.empty())
-                            params += ", ";
-                        params += fmt::format("{}: {}", param.name.plain, param.type.plain);
-                    }
+            ordered.push_back(&funcInfo);
+        }
+        return ordered;
+    }
+
+    auto key = [](const FunctionInfo *funcInfo) {
+        std::vector<int> ranks;
+        for (const auto &param : funcInfo->parameters) {
+            ranks.push_back(dispatchRank(param));
+        }
+        auto worst = ranks.empty() ? -1 : *std::max_element(ranks.begin(), ranks.end());
+        return std::make_pair(worst, std::move(ranks));
+    };
+
+    // Each group at the position of its first overload
+    std::set<std::string> placed;
+    for (const auto &funcInfo : functions) {
+        auto name = qualifiedName(funcInfo);
+        if (!placed.insert(name).second) {
+            continue;
+        }
+        auto group = overloads.at(name);
+        std::stable_sort(group.begin(), group.end(), [&key](const FunctionInfo *a, const FunctionInfo *b) { return key(a) < key(b); });
+        ordered.insert(ordered.end(), group.begin(), group.end());
+    }
+    return ordered;
+}
+
+/**
+ * @brief Whether the parameter is bound with noconvert(), i.e. only accepts its own Python type.
+ *
+ * With orderOverloads, for bool parameters of an overload that has a sibling taking an integer or floating point
+ * number at that position and the same types everywhere else. The bool overload is registered first, so without
+ * noconvert() it would take every number (anything with __bool__) in the converting pass. Floating point parameters
+ * keep converting: they are registered before the integer siblings and get the numbers that are not Python ints.
+ */
+bool isNoConvert(const FunctionInfo &funcInfo, size_t index, const OverloadGroups &overloads, const GeneratorOptions &options) {
+    if (!options.orderOverloads || dispatchRank(funcInfo.parameters[index]) != 0) {
+        return false;
+    }
+    const auto &group = overloads.at(qualifiedName(funcInfo));
+    return std::any_of(group.begin(), group.end(), [&](const FunctionInfo *sibling) {
+        auto rank = sibling->parameters.size() == funcInfo.parameters.size() ? dispatchRank(sibling->parameters[index]) : 0;
+        if (sibling == &funcInfo || (rank != 1 && rank != 2)) {
+            return false;
+        }
+        for (size_t i = 0; i < funcInfo.parameters.size(); ++i) {
+            if (i != index && sibling->parameters[i].type.qualified != funcInfo.parameters[i].type.qualified) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+namespace {
+/**
+ * @brief The extracted struct or enum with a qualified name, nullptr if there is none.
+ */
+using StructLookup = std::function<const StructInfo *(const std::string &)>;
+
+StructLookup lookupIn(const Structs &structs) {
+    auto byName = std::make_shared<std::unordered_map<std::string, const StructInfo *>>();
+    for (const auto &structInfo : structs) {
+        byName->emplace(structInfo.name.qualified.empty() ? structInfo.name.plain : structInfo.name.qualified, &structInfo);
+    }
+    return [byName](const std::string &name) -> const StructInfo * {
+        auto it = byName->find(name);
+        return it == byName->end() ? nullptr : it->second;
+    };
+}
+
+/**
+ * @brief Adds the extracted structs and enums a type refers to: itself, what it points to, its elements and its
+ * template or function arguments.
+ */
+void addReferencedStructs(TypeIndex index, const StructLookup &lookup, std::vector<const StructInfo *> &referenced) {
+    if (index == noType) {
+        return;
+    }
+    const auto &type = TypeTable::shared()[index];
+    if (type.kind == TypeInfo::Kind::Record || type.kind == TypeInfo::Kind::Enum) {
+        // Instantiations are extracted under the name with their arguments, e.g. "alpha::Matrix<float>"
+        const auto *info = lookup(type.name);
+        if (info == nullptr) {
+            std::string_view spelling = type.spelling;
+            for (std::string_view qualifier : {"const ", "volatile "}) {
+                if (spelling.starts_with(qualifier)) {
+                    spelling.remove_prefix(qualifier.size());
                 }
+            }
+            info = lookup(normalizeType(std::string(spelling)));
+        }
+        if (info != nullptr) {
+            referenced.push_back(info);
+        }
+    }
+    addReferencedStructs(type.element, lookup, referenced);
+    for (auto argument : type.arguments) {
+        addReferencedStructs(argument, lookup, referenced);
+    }
+}
+
+/**
+ * @brief The user headers to include for a set of declarations: the ones defining them and the structs and enums in
+ * their fields and signatures, as they are spelled by the sources including them.
+ *
+ * Only the direct includes of the sources are known to resolve from the generated code. If a declaration is defined
+ * anywhere else (a header reached through another header, IR without defining files), all of them are included. A
+ * referenced struct defined elsewhere is left to the header of the declaration referring to it.
+ */
+std::set<std::string> userIncludes(const Structs &structs, const Functions &functions, const StructLookup &lookup,
+                                   const Headers &headers) {
+    std::unordered_map<std::string, std::string> direct; // Real path to the include as spelled
+    std::set<std::string>                        all;
+    for (const auto &header : headers) {
+        if (header.isDirect && !header.isSystem) {
+            direct.emplace(header.fullPath, header.name);
+            all.insert(header.name);
+        }
+    }
+
+    std::set<std::string>           includes;
+    std::vector<const StructInfo *> referenced;
+    bool                            complete = true;
+    auto                            defining = [&](const std::string &file) {
+        auto it = direct.find(file);
+        if (it == direct.end()) {
+            complete = false;
+        } else {
+            includes.insert(it->second);
+        }
+    };
+    auto referencing = [&](const FunctionInfo &funcInfo) {
+        for (const auto &param : funcInfo.parameters) {
+            addReferencedStructs(param.typeIndex, lookup, referenced);
+        }
+        addReferencedStructs(funcInfo.returnTypeIndex, lookup, referenced);
+    };
+
+    for (const auto &structInfo : structs) {
+        defining(structInfo.definingFile);
+        for (const auto &member : structInfo.members) {
+            addReferencedStructs(member.typeIndex, lookup, referenced);
+        }
+        for (const auto &constructor : structInfo.constructors) {
+            referencing(constructor);
+        }
+    }
+    for (const auto &funcInfo : functions) {
+        defining(funcInfo.definingFile);
+        referencing(funcInfo);
+    }
+    if (!complete) {
+        return all;
+    }
+
+    for (const auto *info : referenced) {
+        if (auto it = direct.find(info->definingFile); it != direct.end()) {
+            includes.insert(it->second);
+        }
+    }
+    return includes;
+}
+
+/**
+ * @brief The structs that need a cppglue::pickle::Fields specialization where structs are bound: the picklable ones
+ * among them, then the picklable structs their fields consist of, recursively.
+ */
+std::vector<const StructInfo *> picklableFields(const Structs &structs, const std::set<std::string> &picklable,
+                                                const StructLookup &lookup) {
+    std::vector<const StructInfo *> pickled;
+    std::set<std::string>           names;
+    for (const auto &structInfo : structs) {
+        auto name = structInfo.name.qualified.empty() ? structInfo.name.plain : structInfo.name.qualified;
+        if (!structInfo.isEnum && picklable.contains(name) && names.insert(name).second) {
+            pickled.push_back(&structInfo);
+        }
+    }
+    for (size_t i = 0; i < pickled.size(); ++i) {
+        std::vector<std::string> nested;
+        for (const auto &field : pickled[i]->members) {
+            isPicklableType(field, picklable, &nested);
+        }
+        for (const auto &name : nested) {
+            const auto *info = lookup(name);
+            if (info != nullptr && names.insert(name).second) {
+                pickled.push_back(info);
+            }
+        }
+    }
+    return pickled;
+}
+
+/**
+ * @brief The macro guarding the cppglue::pickle::Fields specialization of a struct, its name with every character
+ * that can not be part of an identifier (and '_') replaced by its hex code, so distinct names get distinct guards.
+ */
+std::string fieldsGuard(const std::string &fullName) {
+    std::string guard = "CPPGLUE_PICKLE_FIELDS_";
+    for (char c : fullName) {
+        if (std::isalnum(static_cast<unsigned char>(c)) != 0) {
+            guard += c;
+        } else {
+            guard += fmt::format("_{:02X}", static_cast<unsigned char>(c));
+        }
+    }
+    return guard;
+}
+
+/**
+ * @brief Writes the parts of the bindings of a set of declarations, so they can be generated as one source or split
+ * into shards (see BindingShard) sharing a header.
+ */
+class BindingWriter {
+  public:
+    BindingWriter(const Structs &structs, const Functions &functions, std::set<std::string> picklable, const GeneratorOptions &options)
+        : structs_(structs), functions_(functions), options_(options), picklable_(std::move(picklable)),
+          buffers_(bufferClasses(structs, functions, options)), overloads_(overloadGroups(functions)),
+          ordered_(registrationOrder(functions, overloads_, options)),
+          callbackAdapters_(options.callbackAdapters && usesCallbacks(structs, functions)), async_(usesAsync(functions, options)) {}
+
+    /**
+     * @brief The pybind11 headers and the helper headers used by the declarations.
+     */
+    void writeIncludes(std::ostream &out) const {
+        out << "#include <pybind11/pybind11.h>\n"
+            << "#include <pybind11/stl.h>\n"
+            << "#include <pybind11/complex.h>\n";
+        // The adapters specialize the std::function caster, they replace functional.h
+        out << (callbackAdapters_ ? "\n#include \"cppglue_callbacks.h\"\n" : "#include <pybind11/functional.h>\n");
+        if (options_.instrument) {
+            out << "\n#include \"cppglue_instrumentation.h\"\n";
+        }
+        if (async_) {
+            out << "\n#include \"cppglue_async.h\"\n";
+        }
+        if (!picklable_.empty()) {
+            out << "\n#include \"cppglue_pickle.h\"\n";
+        }
+        if (!buffers_.empty()) {
+            out << "\n#include \"cppglue_buffer.h\"\n";
+        }
+        if (usesBytes(functions_, options_)) {
+            out << "\n#include \"cppglue_bytes.h\"\n";
+        }
+    }
 
-                // Add function with documentation
-                out << fmt::format("        .def(\"{}\", &{}::{}", funcInfo.name.plain, fullName, funcInfo.name.plain);
-
-                // Add parameter names if present
-                if (funcInfo.hasParameters()) {
-                    out << ", ";
-                    bool first = true;
-                    for (const auto &param : funcInfo.parameters) {
-                        if (!first)
-                            out << ", ";
-                        out << "py::arg(\"" << param.name.plain << "\")";
-                        first = false;
+    /**
+     * @brief The user headers, see userIncludes.
+     */
+    static void writeUserHeaders(const std::set<std::string> &userHeaders, std::ostream &out) {
+        out << "\n// User headers" << (userHeaders.empty() ? " - [none found] \n" : "\n");
+        for (const auto &header : userHeaders) {
+            out << "#include \"" << header << "\"\n";
+        }
+    }
+
+    /**
+     * @brief The system headers the sources include directly, as comments.
+     */
+    static void writeSystemHeaders(const Headers &headers, std::ostream &out) {
+        std::set<std::string> systemHeaders;
+        for (const auto &header : headers) {
+            if (header.isDirect && header.isSystem) {
+                systemHeaders.insert(header.name);
+            }
+        }
+
+        out << "\n// System headers" << (systemHeaders.empty() ? " - [none found] \n" : "\n");
+        for (const auto &header : systemHeaders) {
+            out << "// #include <" << header << ">\n";
+        }
+    }
+
+    /**
+     * @brief The fields pickled for structs that can not be copied with one memcpy, see picklableFields. With guarded
+     * each specialization is defined once per translation unit, for shards pickling the same struct built as one.
+     */
+    static void writeFields(const std::vector<const StructInfo *> &pickled, std::ostream &out, bool guarded = false) {
+        if (pickled.empty()) {
+            return;
+        }
+        out << "\nnamespace cppglue::pickle {\n";
+        for (const auto *structInfo : pickled) {
+            auto fullName = getFullName(*structInfo);
+            if (guarded) {
+                out << fmt::format("#ifndef {0}\n#define {0}\n", fieldsGuard(fullName));
+            }
+            out << fmt::format("template <> struct Fields<{}> {{\n", fullName)
+                << "    template <typename Visit, typename Self> static void fields(Visit &&visit, Self &self) {\n";
+            for (const auto &member : structInfo->members) {
+                out << fmt::format("        visit(self.{});\n", member.name.plain);
+            }
+            out << "    }\n};\n";
+            if (guarded) {
+                out << "#endif\n";
+            }
+        }
+        out << "} // namespace cppglue::pickle\n";
+    }
+
+    /**
+     * @brief The statements configuring the helper headers, first in the module.
+     */
+    void writeSetup(std::ostream &out) const {
+        if (callbackAdapters_ && options_.queueCallbacks) {
+            out << "    cppglue::callbacks::setQueueFromThreads(true);\n\n";
+        }
+        if (async_) {
+            if (options_.asyncThreads != 0) {
+                out << fmt::format("    cppglue::async::setThreadCount({});\n", options_.asyncThreads);
+            }
+            out << "    cppglue::async::registerShutdown();\n\n";
+        }
+    }
+
+    /**
+     * @brief The enums with their values and the class objects, registered before any function so signatures name them.
+     */
+    void writeDeclarations(std::ostream &out) const {
+        for (const auto &structInfo : structs_) {
+            if (structInfo.isEnum) {
+                out << fmt::format("    py::enum_<{0}>(m, \"{1}\", py::arithmetic())\n", getFullName(structInfo), structInfo.name.plain);
+                for (const auto &member : structInfo.members) {
+                    out << fmt::format("        .value(\"{0}\", {1}::{0})\n", member.name.plain, getFullName(structInfo));
+                }
+                out << "        .export_values();\n\n";
+            } else {
+                out << fmt::format("    py::class_<{0}> {1}(m, \"{2}\"{3});\n", getFullName(structInfo), structInfo.name.plain + "_class",
+                                   structInfo.name.plain, buffers_.contains(getFullName(structInfo)) ? ", py::buffer_protocol()" : "");
+            }
+        }
+    }
+
+    /**
+     * @brief The members of the classes and the free functions. With lookUpClasses the class objects are taken from the
+     * module, for definitions written in another function than the declarations.
+     */
+    void writeDefinitions(std::ostream &out, bool lookUpClasses = false) const {
+        for (const auto &structInfo : structs_) {
+            if (structInfo.isEnum) {
+                continue; // Already handled
+            }
+
+            std::string className = structInfo.name.plain + "_class";
+            std::string fullName  = getFullName(structInfo);
+
+            if (lookUpClasses) {
+                out << fmt::format("    auto {0} = py::reinterpret_borrow<py::class_<{1}>>(m.attr(\"{2}\"));\n", className, fullName,
+                                   structInfo.name.plain);
+            }
+
+            // Main class definition
+            // Every chained call starts on a new line, so the statement can be closed without rewinding the stream
+            out << fmt::format("    {0}", className);
+            if (structInfo.isDefaultConstructible) {
+                out << "\n        .def(py::init<>())";
+            }
+            out << constructorBindings(structInfo, fullName);
+            if (picklable_.contains(fullName)) {
+                out << fmt::format("\n        .def(cppglue::pickle::pickler<{}>())", fullName);
+            }
+            if (auto buffer = buffers_.find(fullName); buffer != buffers_.end()) {
+                std::string layout = buffer->second.data;
+                for (const auto &extent : buffer->second.extents) {
+                    layout += ", " + extent;
+                }
+                out << fmt::format("\n        .def_buffer([]({} &self) {{ return cppglue::buffer::contiguous({}); }})", fullName, layout);
+            }
+
+            // Add members
+            for (const auto &member : structInfo.members) {
+                out << fmt::format("\n        .def_readwrite(\"{0}\", &{1}::{0})", member.name.plain, fullName);
+            }
+
+            // Add member functions
+            for (const auto *function : ordered_) {
+                const auto &funcInfo = *function;
+                if (funcInfo.parent.has_value() && funcInfo.parent->qualified == fullName) {
+                    auto params = parameterDoc(funcInfo);
+
+                    // Add function with documentation
+                    out << fmt::format("\n        .def(\"{}\", {}", funcInfo.name.plain,
+                                       target(structInfo.name.plain + "." + funcInfo.name.plain, funcInfo));
+
+                    // Add parameter names if present
+                    out << arguments(funcInfo);
+
+                    // Add docstring with type information
+                    out << fmt::format(", \"{}({}){}\"{}", funcInfo.name.plain, params,
+                                       funcInfo.returnType.plain.empty() ? "" : " -> " + funcInfo.returnType.plain,
+                                       funcInfo.isPureVirtual ? ", py::is_method()" : "");
+
+                    out << ")";
+
+                    if (takesBytes(funcInfo, options_)) {
+                        out << "\n        .def(" << bytesBinding(funcInfo, structInfo.name.plain + "." + funcInfo.name.plain) << ")";
+                    }
+                    if (isAsync(funcInfo, options_)) {
+                        out << "\n        .def(" << asyncBinding(funcInfo, params) << ")";
                     }
                 }
+            }
+            out << ";\n\n";
+        }
+
+        // Generate free function bindings
+        for (const auto *function : ordered_) {
+            const auto &funcInfo = *function;
+            if (funcInfo.isMemberFunction) {
+                continue; // Already handled
+            }
 
-                // Add docstring with type information
-                out << fmt::format(", \"{}({}){}\"{}", funcInfo.name.plain, params,
-                                   funcInfo.returnType.plain.empty() ? "" : " -> " + funcInfo.returnType.plain,
-                                   funcInfo.isPureVirtual ? ", py::is_method()" : "");
+            auto params = parameterDoc(funcInfo);
 
-                out << ")\n";
+            out << fmt::format("    m.def(\"{}\", {}", funcInfo.name.plain, target(funcInfo.name.plain, funcInfo));
+
+            // Add parameter names if present
+            out << arguments(funcInfo);
+
+            // Add docstring with type information
+            out << fmt::format(", \"{}({}){}\");\n", funcInfo.name.plain, params,
+                               funcInfo.returnType.plain.empty() ? "" : " -> " + funcInfo.returnType.plain);
+
+            if (takesBytes(funcInfo, options_)) {
+                out << "    m.def(" << bytesBinding(funcInfo, funcInfo.name.plain) << ");\n";
+            }
+            if (isAsync(funcInfo, options_)) {
+                out << "    m.def(" << asyncBinding(funcInfo, params) << ");\n";
             }
         }
-        // Remove last newline and add semicolon
-        out.seekp(-1, std::ios_base::end);
-        out << ";\n\n";
     }
 
-    // Generate free function bindings
-    for (const auto &funcInfo : functions) {
-        if (funcInfo.isMemberFunction) {
-            continue; // Already handled
+    /**
+     * @brief The module functions of the helper headers, last in the module.
+     */
+    void writeHelpers(std::ostream &out) const {
+        if (callbackAdapters_) {
+            out << "\n    m.def(\"_drain_callbacks\", &cppglue::callbacks::drain,\n"
+                << "          \"Runs the callback invocations queued by threads not holding the GIL, returns how many ran\");\n";
+        }
+
+        if (options_.instrument) {
+            out << "\n    m.def(\"_cppglue_stats\", &cppglue::instrumentation::stats, py::arg(\"reset\") = false,\n"
+                << "          \"Per binding: calls, errors, total_ns, body_ns and conversion_ns, reset=True zeroes the counters\");\n";
         }
+    }
 
-        // Build parameter documentation string
+  private:
+    // Helper function to get fully qualified name
+    static std::string getFullName(const StructInfo &s) { return s.name.qualified.empty() ? s.name.plain : s.name.qualified; }
+
+    // Build parameter documentation string
+    static std::string parameterDoc(const FunctionInfo &funcInfo) {
         std::string params;
         if (funcInfo.hasParameters()) {
             for (const auto &param : funcInfo.parameters) {
@@ -127,128 +1027,373 @@ void generateBindings(const Structs &structs, const Functions &functions, const
                 params += fmt::format("{}: {}", param.name.plain, param.type.plain);
             }
         }
+        return params;
+    }
+
+    // Pointer to the function, overloads are selected by their exact parameter types (and const for methods)
+    [[nodiscard]] std::string pointer(const FunctionInfo &funcInfo) const {
+        auto name = qualifiedName(funcInfo);
+        if (overloads_.at(name).size() < 2) {
+            return "&" + name;
+        }
+        std::string types;
+        for (const auto &param : funcInfo.parameters) {
+            types += (types.empty() ? "" : ", ") + param.type.qualified;
+        }
+        return fmt::format("py::overload_cast<{}>(&{}{})", types, name, funcInfo.isConst ? ", py::const_" : "");
+    }
 
-        out << fmt::format("    m.def(\"{}\", &{}", funcInfo.name.plain,
-                           funcInfo.name.qualified.empty() ? funcInfo.name.plain : funcInfo.name.qualified);
+    // The bound function, wrapped in counters and timers when instrumenting, statsName is its key in _cppglue_stats()
+    [[nodiscard]] std::string target(const std::string &statsName, const FunctionInfo &funcInfo) const {
+        return options_.instrument ? fmt::format("cppglue::instrumentation::wrap(\"{}\", {})", statsName, pointer(funcInfo))
+                                   : pointer(funcInfo);
+    }
 
-        // Add parameter names if present
-        if (funcInfo.hasParameters()) {
-            out << ", ";
-            bool first = true;
-            for (const auto &param : funcInfo.parameters) {
-                if (!first)
-                    out << ", ";
-                out << "py::arg(\"" << param.name.plain << "\")";
-                first = false;
+    // The py::arg of every parameter, each preceded by a comma
+    [[nodiscard]] std::string arguments(const FunctionInfo &funcInfo) const {
+        std::string args;
+        for (size_t i = 0; i < funcInfo.parameters.size(); ++i) {
+            args += fmt::format(", py::arg(\"{}\"){}", funcInfo.parameters[i].name.plain,
+                                isNoConvert(funcInfo, i, overloads_, options_) ? ".noconvert()" : "");
+        }
+        return args;
+    }
+
+    // Name, function and extras of the awaitable variant, the future keeps self and pointer arguments alive
+    [[nodiscard]] std::string asyncBinding(const FunctionInfo &funcInfo, const std::string &params) const {
+        std::string binding =
+            fmt::format("\"{0}{1}\", cppglue::async::wrap({2}){3}", funcInfo.name.plain, options_.asyncSuffix, pointer(funcInfo),
+                        arguments(funcInfo));
+
+        size_t index = 1; // pybind11 counts self as argument 1
+        if (funcInfo.isMemberFunction) {
+            binding += ", py::keep_alive<0, 1>()";
+            ++index;
+        }
+        for (const auto &param : funcInfo.parameters) {
+            if (param.isPointer) {
+                binding += fmt::format(", py::keep_alive<0, {}>()", index);
             }
+            ++index;
+        }
+
+        return binding + fmt::format(", \"{}{}({}) -> Awaitable[{}]\"", funcInfo.name.plain, options_.asyncSuffix, params,
+                                     funcInfo.returnType.plain.empty() ? "void" : funcInfo.returnType.plain);
+    }
+
+    // Overload viewing bytes, bytearray, memoryview and other contiguous buffers as the std::string_view parameters,
+    // registered after the function itself so str arguments keep their conversion
+    [[nodiscard]] std::string bytesBinding(const FunctionInfo &funcInfo, const std::string &statsName) const {
+        std::string parameters;
+        if (funcInfo.isMemberFunction) {
+            parameters = fmt::format("{}{} &self", funcInfo.isConst ? "const " : "", funcInfo.parent->qualified);
+        }
+        std::string call;
+        std::string doc;
+        for (size_t i = 0; i < funcInfo.parameters.size(); ++i) {
+            const auto &param = funcInfo.parameters[i];
+            auto        name  = "arg" + std::to_string(i);
+            bool        view  = isStringView(param);
+            parameters += (parameters.empty() ? "" : ", ") + (view ? "const py::buffer &" : param.type.qualified + " ") + name;
+            call += (call.empty() ? "" : ", ") +
+                    (view ? "cppglue::bytes::View(" + name + ")" : isRvalueReference(param) ? "std::move(" + name + ")" : name);
+            doc += (doc.empty() ? "" : ", ") + param.name.plain + ": " + (view ? "buffer" : param.type.plain);
         }
 
-        // Add docstring with type information
-        out << fmt::format(", \"{}({}){}\");\n", funcInfo.name.plain, params,
+        auto callee = funcInfo.isMemberFunction ? "self." + funcInfo.name.plain : qualifiedName(funcInfo);
+        auto lambda = fmt::format("[]({}) {{ return {}({}); }}", parameters, callee, call);
+        return fmt::format("\"{}\", {}{}, \"{}({}){}\"", funcInfo.name.plain,
+                           options_.instrument ? fmt::format("cppglue::instrumentation::wrap(\"{}\", +{})", statsName, lambda) : lambda,
+                           arguments(funcInfo), funcInfo.name.plain, doc,
                            funcInfo.returnType.plain.empty() ? "" : " -> " + funcInfo.returnType.plain);
     }
 
+    const Structs                    &structs_;
+    const Functions                  &functions_;
+    const GeneratorOptions           &options_;
+    std::set<std::string>             picklable_;
+    Buffers                           buffers_;
+    OverloadGroups                    overloads_;
+    std::vector<const FunctionInfo *> ordered_;
+    bool                              callbackAdapters_;
+    bool                              async_;
+};
+} // namespace
+
+void generateBindings(const Structs &structs, const Functions &functions, const Headers &headers, const std::string &moduleName,
+                      std::ostream &out, const GeneratorOptions &options) {
+    auto          lookup    = lookupIn(structs);
+    auto          picklable = picklableStructs(structs, options);
+    BindingWriter writer(structs, functions, picklable, options);
+    writer.writeIncludes(out);
+    BindingWriter::writeUserHeaders(userIncludes(structs, functions, lookup, headers), out);
+    BindingWriter::writeSystemHeaders(headers, out);
+    BindingWriter::writeFields(picklableFields(structs, picklable, lookup), out);
+
+    out << "\nnamespace py = pybind11;\n\n";
+    out << "PYBIND11_MODULE(" << moduleName << ", m) {\n";
+    writer.writeSetup(out);
+
+    // First, declare all enums and classes
+    writer.writeDeclarations(out);
+
+    // Then, define the actual bindings for non-enum classes and the free functions
+    writer.writeDefinitions(out);
+
+    writer.writeHelpers(out);
     out << "}\n";
 }
 
 namespace {
-// Add at top of anonymous namespace
-struct TemplateProcessor {
-    static std::string replace(std::string templ, const std::string &placeholder, const std::string &value) {
-        size_t pos;
-        while ((pos = templ.find(placeholder)) != std::string::npos) {
-            templ.replace(pos, placeholder.length(), value);
+/**
+ * @brief The scope a qualified name is declared in, empty for the global namespace. Separators inside template
+ * arguments are skipped: the scope of "alpha::Matrix<beta::Cell>" is "alpha".
+ */
+std::string enclosingScope(const std::string &qualifiedName) {
+    int    depth = 0;
+    size_t end   = 0;
+    for (size_t i = 0; i + 1 < qualifiedName.size(); ++i) {
+        depth += qualifiedName[i] == '<' ? 1 : qualifiedName[i] == '>' ? -1 : 0;
+        if (depth == 0 && qualifiedName[i] == ':' && qualifiedName[i + 1] == ':') {
+            end = i++;
         }
-        return templ;
     }
-};
+    return qualifiedName.substr(0, end);
+}
 
-class FileWriter {
-  public:
-    static void writeIfDifferent(const std::filesystem::path &path, const std::string &content) {
-        if (shouldWrite(path, content)) {
-            std::ofstream out(path);
-            if (!out) {
-                throw std::runtime_error("Failed to open file for writing: " + path.string());
-            }
-            out << content;
-            std::cout << "Generated: " << path << '\n';
+/**
+ * @brief The scope as part of a C++ identifier and file name, "alpha::detail" becomes "alpha__detail".
+ */
+std::string shardIdentifier(const std::string &scope) {
+    if (scope.empty()) {
+        return "global";
+    }
+    std::string id;
+    for (size_t i = 0; i < scope.size(); ++i) {
+        if (scope.compare(i, 2, "::") == 0) {
+            id += "__";
+            ++i;
         } else {
-            std::cout << "Skipped unchanged file: " << path << '\n';
+            id += std::isalnum(static_cast<unsigned char>(scope[i])) != 0 ? scope[i] : '_';
         }
     }
+    return id;
+}
+
+/**
+ * @brief The declarations of a shard, copied out of the declarations of the module.
+ */
+std::pair<Structs, Functions> shardDeclarations(const BindingShard &shard, const Structs &structs, const Functions &functions) {
+    Structs shardStructs;
+    shardStructs.reserve(shard.structs.size());
+    for (auto index : shard.structs) {
+        shardStructs.push_back(structs[index]);
+    }
+    Functions shardFunctions;
+    shardFunctions.reserve(shard.functions.size());
+    for (auto index : shard.functions) {
+        shardFunctions.push_back(functions[index]);
+    }
+    return {std::move(shardStructs), std::move(shardFunctions)};
+}
 
-    static void ensureDirectory(const std::filesystem::path &path) {
-        if (!std::filesystem::exists(path)) {
-            if (!std::filesystem::create_directories(path)) {
-                throw std::runtime_error("Failed to create directory: " + path.string());
+/**
+ * @brief Runs work(i) for every i below count on up to hardware_concurrency threads.
+ */
+template <typename Work> void parallelFor(size_t count, Work &&work) {
+    auto                     threads = std::min<size_t>(count, std::max(1U, std::thread::hardware_concurrency()));
+    std::atomic<size_t>      next{0};
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (auto i = next++; i < count; i = next++) {
+                work(i);
             }
-            std::cout << "Created directory: " << path << '\n';
-        }
+        });
     }
+    for (auto i = next++; i < count; i = next++) {
+        work(i);
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+} // namespace
 
-  private:
-    static bool shouldWrite(const std::filesystem::path &path, const std::string &newContent) {
-        if (!std::filesystem::exists(path))
-            return true;
+BindingShard &ShardPartition::add(const StructInfo &structInfo, size_t index) {
+    structs_.emplace(structInfo.name.qualified.empty() ? structInfo.name.plain : structInfo.name.qualified, index);
+    auto &shard = shardOf(structInfo.name.qualified);
+    shard.structs.push_back(index);
+    shard.dirty = true;
+    return shard;
+}
 
-        std::ifstream file(path);
-        if (!file)
-            return true;
+BindingShard &ShardPartition::add(const FunctionInfo &funcInfo, size_t index) {
+    // The scope of a member function is its class, the class is in the scope enclosing it
+    auto &shard = shardOf(funcInfo.isMemberFunction && funcInfo.parent.has_value() ? funcInfo.parent->qualified : funcInfo.name.qualified);
+    shard.functions.push_back(index);
+    shard.dirty = true;
+    return shard;
+}
+
+std::optional<size_t> ShardPartition::find(const std::string &qualifiedName) const {
+    auto it = structs_.find(qualifiedName);
+    return it == structs_.end() ? std::nullopt : std::optional<size_t>(it->second);
+}
 
-        std::string existingContent((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-        return existingContent != newContent;
+BindingShard &ShardPartition::shardOf(const std::string &qualifiedName) {
+    auto scope = enclosingScope(qualifiedName);
+    if (auto it = scopes_.find(scope); it != scopes_.end()) {
+        return shards_[it->second];
     }
-};
 
-std::string readTemplate(const std::string &templateName) {
-    // Template file is installed alongside the executable
-    std::filesystem::path exePath      = std::filesystem::canonical("/proc/self/exe");
-    auto                  templatePath = exePath.parent_path() / "templates" / templateName;
+    auto id = shardIdentifier(scope);
+    for (size_t suffix = 2; ids_.contains(id); ++suffix) {
+        id = shardIdentifier(scope) + "_" + std::to_string(suffix);
+    }
+    ids_.insert(id);
+    scopes_.emplace(scope, shards_.size());
 
-    std::ifstream file(templatePath);
-    if (!file) {
-        throw std::runtime_error("Failed to open template file: " + templatePath.string());
+    auto &shard = shards_.emplace_back();
+    shard.scope = scope;
+    shard.id    = id;
+    return shard;
+}
+
+bool renderShard(ShardPartition &partition, size_t index, const Structs &structs, const Functions &functions, const Headers &headers,
+                 const std::set<std::string> *picklable, const std::string &moduleName, const GeneratorOptions &options) {
+    auto &shard                         = partition.shards()[index];
+    auto [shardStructs, shardFunctions] = shardDeclarations(shard, structs, functions);
+    auto lookup                         = [&partition, &structs](const std::string &name) -> const StructInfo * {
+        auto found = partition.find(name);
+        return found ? &structs[*found] : nullptr;
+    };
+
+    // The structs whose fields the shard pickles, picklable in the module
+    auto guess    = picklable == nullptr ? picklableStructs(shardStructs, options) : std::set<std::string>{};
+    auto pickled  = picklableFields(shardStructs, picklable != nullptr ? *picklable : guess, lookup);
+    auto includes = userIncludes(shardStructs, shardFunctions, lookup, headers);
+    std::set<std::string> pickledNames;
+    for (const auto *structInfo : pickled) {
+        pickledNames.insert(structInfo->name.qualified.empty() ? structInfo->name.plain : structInfo->name.qualified);
+    }
+    if (!shard.dirty && pickledNames == shard.picklable && includes == shard.includes) {
+        return false;
     }
 
-    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    BindingWriter     writer(shardStructs, shardFunctions, pickledNames, options);
+    std::stringstream out;
+    out << "#include \"" << moduleName << "_bindings.h\"\n";
+    BindingWriter::writeUserHeaders(includes, out);
+    // Shards pickling a struct of another shard repeat its fields, for unity builds only the first one is compiled
+    BindingWriter::writeFields(pickled, out, true);
+    out << "\nvoid cppglue_declare_" << shard.id << "([[maybe_unused]] py::module_ &m) {\n";
+    writer.writeDeclarations(out);
+    out << "}\n\n"
+        << "void cppglue_define_" << shard.id << "([[maybe_unused]] py::module_ &m) {\n";
+    writer.writeDefinitions(out, true);
+    out << "}\n";
+
+    shard.code      = out.str();
+    shard.picklable = std::move(pickledNames);
+    shard.includes  = std::move(includes);
+    shard.dirty     = false;
+    return true;
 }
 
-std::string generateCMakeLists(const std::string &moduleName, const Headers &headers) {
-    std::string templ = readTemplate("CMakeLists.txt.template");
+size_t renderShards(ShardPartition &partition, const Structs &structs, const Functions &functions, const Headers &headers,
+                    const std::set<std::string> &picklable, const std::string &moduleName, const GeneratorOptions &options) {
+    std::atomic<size_t> rendered{0};
+    parallelFor(partition.shards().size(), [&](size_t i) {
+        if (renderShard(partition, i, structs, functions, headers, &picklable, moduleName, options)) {
+            ++rendered;
+        }
+    });
+    return rendered;
+}
+
+namespace {
+/**
+ * @brief The commands applying the build options to the module target, empty if none is set.
+ */
+std::string buildOptions(const Headers &headers, const std::vector<std::string> &sources, const GeneratorOptions &options) {
+    std::stringstream out;
+    if (!sources.empty()) {
+        out << "target_sources(${PROJECT_NAME} PRIVATE";
+        for (const auto &source : sources) {
+            out << "\n    " << source;
+        }
+        out << ")\n";
+    }
+    if (options.precompileHeaders) {
+        // The headers every binding source includes first, functional.h is left out as the callback adapters replace it
+        out << "target_precompile_headers(${PROJECT_NAME} PRIVATE\n"
+            << "    <pybind11/pybind11.h>\n"
+            << "    <pybind11/stl.h>\n"
+            << "    <pybind11/complex.h>";
+        for (const auto &header : headers) {
+            if (header.isDirect && !header.isSystem) {
+                out << "\n    \"" << header.fullPath << "\"";
+            }
+        }
+        out << ")\n";
+    }
+    if (options.unityBatchSize > 0) {
+        out << "set_target_properties(${PROJECT_NAME} PROPERTIES UNITY_BUILD ON UNITY_BUILD_BATCH_SIZE " << options.unityBatchSize << ")\n";
+    }
+    if (options.hiddenVisibility) {
+        out << "set_target_properties(${PROJECT_NAME} PROPERTIES CXX_VISIBILITY_PRESET hidden VISIBILITY_INLINES_HIDDEN ON)\n";
+    }
+    if (options.gcSections) {
+        out << "if(MSVC)\n"
+            << "    target_compile_options(${PROJECT_NAME} PRIVATE /Gy /Gw)\n"
+            << "    target_link_options(${PROJECT_NAME} PRIVATE /OPT:REF /OPT:ICF)\n"
+            << "else()\n"
+            << "    target_compile_options(${PROJECT_NAME} PRIVATE -ffunction-sections -fdata-sections)\n"
+            << "    if(APPLE)\n"
+            << "        target_link_options(${PROJECT_NAME} PRIVATE LINKER:-dead_strip)\n"
+            << "    else()\n"
+            << "        target_link_options(${PROJECT_NAME} PRIVATE LINKER:--gc-sections)\n"
+            << "    endif()\n"
+            << "endif()\n";
+    }
+
+    auto commands = out.str();
+    return commands.empty() ? commands : "\n" + commands;
+}
 
+/**
+ * @brief The CMakeLists.txt of the module, sources are the binding sources next to <moduleName>.cpp.
+ */
+std::string generateCMakeLists(const std::string &moduleName, const Headers &headers, const std::vector<std::string> &sources,
+                               const GeneratorOptions &options) {
     // Generate header fileset section
     std::stringstream headerFiles;
     headerFiles << "# Direct header dependencies (that you must resolve!):\n";
     for (const auto &header : headers) {
-        if (!header.isSystem) {
+        if (header.isDirect && !header.isSystem) {
             headerFiles << "# " << header.fullPath << "\n";
         }
     }
-    headerFiles << "\n";
-
-    templ = TemplateProcessor::replace(templ, "{module_name}", moduleName);
 
-    // Insert header files section after the project() line
-    size_t pos;
-    if ((pos = templ.find("project(")) != std::string::npos) {
-        pos = templ.find('\n', pos) + 1;
-        templ.insert(pos, headerFiles.str());
-    }
-
-    return templ;
+    auto headerSection = headerFiles.str();
+    auto build         = buildOptions(headers, sources, options);
+    return TemplateProcessor::render<templateIndex("CMakeLists.txt.template")>({.moduleName    = moduleName,
+                                                                               .headerFiles   = headerSection,
+                                                                               .moduleOptions = options.thinLto ? " THIN_LTO" : "",
+                                                                               .buildOptions  = build});
 }
 
 std::string generateCPM(const std::string &version) {
-    return TemplateProcessor::replace(readTemplate("CPM.cmake.template"), "{version}", version);
+    return TemplateProcessor::render<templateIndex("CPM.cmake.template")>({.version = version});
 }
 
 std::string generateSetupPy(const std::string &moduleName) {
-    return TemplateProcessor::replace(readTemplate("setup.py.template"), "{module_name}", moduleName);
+    return TemplateProcessor::render<templateIndex("setup.py.template")>({.moduleName = moduleName});
 }
 
 std::string generatePyprojectToml(const std::string &moduleName) {
-    return TemplateProcessor::replace(readTemplate("pyproject.toml.template"), "{module_name}", moduleName);
+    return TemplateProcessor::render<templateIndex("pyproject.toml.template")>({.moduleName = moduleName});
 }
 
 std::string toPythonType(const std::string &cppType) {
@@ -333,15 +1478,190 @@ std::string toPythonType(const std::string &cppType) {
     return cppType;
 }
 
-std::string generatePyi(const Structs &structs, const Functions &functions) {
-    std::stringstream out;
+/**
+ * @brief Python annotations of the interned types, each built once from its TypeInfo and then looked up by index.
+ *
+ * Bound classes and enums are named like in the module (instantiations by their alias). Types without a TypeInfo,
+ * from IR exported before types were interned, fall back to parsing their spelling with toPythonType.
+ */
+class PythonTypes {
+  public:
+    explicit PythonTypes(const Structs &structs) {
+        for (const auto &structInfo : structs) {
+            bound_.emplace(structInfo.name.qualified.empty() ? structInfo.name.plain : structInfo.name.qualified, structInfo.name.plain);
+        }
+    }
+
+    const std::string &of(const FieldDeclarationInfo &field) { return of(field.typeIndex, field.type.plain); }
+
+    const std::string &resultOf(const FunctionInfo &funcInfo) {
+        static const std::string none = "None";
+        if (funcInfo.returnTypeIndex == noType && funcInfo.returnType.plain.empty()) {
+            return none;
+        }
+        return of(funcInfo.returnTypeIndex, funcInfo.returnType.plain);
+    }
+
+  private:
+    const std::string &of(TypeIndex index, const std::string &spelling) {
+        if (index == noType) {
+            auto it = parsed_.find(spelling);
+            return it != parsed_.end() ? it->second : parsed_.emplace(spelling, toPythonType(spelling)).first->second;
+        }
+        if (auto it = names_.find(index); it != names_.end()) {
+            return it->second;
+        }
+        auto name = build(index); // Before the insertion, it looks up the types this one is built from
+        return names_.emplace(index, std::move(name)).first->second;
+    }
+
+    std::string build(TypeIndex index) {
+        const auto &type     = TypeTable::shared()[index];
+        auto        argument = [this, &type](size_t i) { return i < type.arguments.size() ? of(type.arguments[i], "") : "object"; };
+        auto        all      = [this, &type] {
+            std::string names;
+            for (auto argument : type.arguments) {
+                names += (names.empty() ? "" : ", ") + of(argument, "");
+            }
+            return names;
+        };
+        auto unscoped = [](const std::string &name) {
+            auto scope = name.rfind("::");
+            return scope == std::string::npos ? name : name.substr(scope + 2);
+        };
+        std::string_view unqualified = type.spelling;
+        for (std::string_view qualifier : {"const ", "volatile "}) {
+            if (unqualified.starts_with(qualifier)) {
+                unqualified.remove_prefix(qualifier.size());
+            }
+        }
+        if (auto it = bound_.find(std::string(unqualified)); it != bound_.end()) {
+            return it->second;
+        }
+
+        static const std::set<std::string_view> characters{"char", "wchar_t", "char8_t", "char16_t", "char32_t"};
+        static const std::set<std::string_view> sequences{"std::vector", "std::list", "std::deque", "std::array", "std::valarray"};
+        switch (type.kind) {
+        case TypeInfo::Kind::Void:
+            return "None";
+        case TypeInfo::Kind::Bool:
+            return "bool";
+        case TypeInfo::Kind::Integer:
+            return characters.contains(unqualified) ? "str" : "int";
+        case TypeInfo::Kind::Floating:
+            return "float";
+        case TypeInfo::Kind::Enum:
+            return unscoped(type.name);
+        case TypeInfo::Kind::Pointer: // const char * is a str like char
+        case TypeInfo::Kind::LValueReference:
+        case TypeInfo::Kind::RValueReference:
+            return of(type.element, "");
+        case TypeInfo::Kind::Array:
+            return "List[" + of(type.element, "") + "]";
+        case TypeInfo::Kind::Function:
+            return "Callable[[" + all() + "], " + of(type.element, "") + "]";
+        case TypeInfo::Kind::Record:
+            if (type.name == "std::basic_string" || type.name == "std::basic_string_view") {
+                return "str";
+            }
+            if (type.name == "std::complex") {
+                return "Complex";
+            }
+            if (sequences.contains(type.name)) {
+                return "List[" + argument(0) + "]";
+            }
+            if (type.name == "std::set" || type.name == "std::unordered_set") {
+                return "Set[" + argument(0) + "]";
+            }
+            if (type.name == "std::map" || type.name == "std::unordered_map") {
+                return "Dict[" + argument(0) + ", " + argument(1) + "]";
+            }
+            if (type.name == "std::optional") {
+                return "Optional[" + argument(0) + "]";
+            }
+            if (type.name == "std::pair" || type.name == "std::tuple") {
+                return "Tuple[" + all() + "]";
+            }
+            if (type.name == "std::variant") {
+                return "Union[" + all() + "]";
+            }
+            if (type.name == "std::function") {
+                return argument(0);
+            }
+            return unscoped(type.name);
+        case TypeInfo::Kind::Other:
+            break;
+        }
+        return type.spelling;
+    }
+
+    std::map<std::string, std::string>            bound_;  // Qualified C++ name to Python name
+    std::unordered_map<TypeIndex, std::string>    names_;  // References stay valid while types are added
+    std::unordered_map<std::string, std::string>  parsed_; // Spellings without TypeInfo
+};
+
+/**
+ * @brief Declares the awaitable variant of a function, a plain def since it returns a Future rather than a coroutine.
+ */
+void writeAsyncStub(const FunctionInfo &funcInfo, const GeneratorOptions &options, const std::string &indent, const std::string &self,
+                    bool overloaded, PythonTypes &types, std::ostream &out) {
+    std::string params = self;
+    for (const auto &param : funcInfo.parameters) {
+        params += (params.empty() ? "" : ", ") + param.name.plain + ": " + types.of(param);
+    }
+    out << (overloaded ? indent + "@overload\n" : "");
+    out << indent << "def " << funcInfo.name.plain << options.asyncSuffix << "(" << params << ") -> Awaitable[" << types.resultOf(funcInfo)
+        << "]: ...\n";
+}
+
+/**
+ * @brief Declares __init__ for every py::init overload of the class, see constructorBindings.
+ */
+void writeInitStubs(const StructInfo &structInfo, PythonTypes &types, std::ostream &out) {
+    auto signature = [&types](const std::vector<FieldDeclarationInfo> &parameters) {
+        std::string params = "self";
+        for (size_t i = 0; i < parameters.size(); ++i) {
+            auto name = parameters[i].name.plain.empty() ? "arg" + std::to_string(i) : parameters[i].name.plain;
+            params += ", " + name + ": " + types.of(parameters[i]);
+        }
+        return params;
+    };
+
+    std::vector<std::string> signatures;
+    if (structInfo.isDefaultConstructible) {
+        signatures.emplace_back("self");
+    }
+    for (const auto &constructor : structInfo.constructors) {
+        signatures.push_back(signature(constructor.parameters));
+    }
+    if (structInfo.isAggregate && structInfo.constructors.empty()) {
+        signatures.push_back(signature(structInfo.members));
+    }
+
+    for (const auto &params : signatures) {
+        out << (signatures.size() > 1 ? "    @overload\n" : "") << "    def __init__(" << params << ") -> None: ...\n";
+    }
+}
+
+void generatePyi(const Structs &structs, const Functions &functions, const GeneratorOptions &options, std::ostream &out) {
+    auto        picklable = picklableStructs(structs, options);
+    auto        buffers   = bufferClasses(structs, functions, options);
+    auto        overloads = overloadGroups(functions);
+    PythonTypes types(structs);
 
     // Add common imports
     out << "from typing import Optional, Callable, List, Dict, Set, Tuple, Union, overload\n"
         << "from typing import TypeVar, Generic, Complex\n" // Added Complex import
         << "from enum import Enum\n"                        // Added Enum import
         << "import numpy.typing as npt\n"
-        << "import numpy as np\n\n";
+        << "import numpy as np\n";
+    if (usesAsync(functions, options)) {
+        out << "from typing import Awaitable\n";
+    }
+    if (!buffers.empty()) {
+        out << "import sys\n";
+    }
+    out << "\n";
 
     // Generate enum definitions
     for (const auto &structInfo : structs) {
@@ -366,69 +1686,220 @@ std::string generatePyi(const Structs &structs, const Functions &functions) {
     for (const auto &structInfo : structs) {
         if (!structInfo.isEnum) {
             out << "class " << structInfo.name.plain << ":\n";
-            out << "    def __init__(self) -> None: ...\n\n";
+            writeInitStubs(structInfo, types, out);
+            if (picklable.contains(structInfo.name.qualified.empty() ? structInfo.name.plain : structInfo.name.qualified)) {
+                out << "    def __getstate__(self) -> bytes: ...\n"
+                    << "    def __setstate__(self, state: bytes) -> None: ...\n";
+            }
+            // Python exposes the buffer protocol of a type as __buffer__ since 3.12 (PEP 688)
+            if (buffers.contains(structInfo.name.qualified.empty() ? structInfo.name.plain : structInfo.name.qualified)) {
+                out << "    if sys.version_info >= (3, 12):\n"
+                    << "        def __buffer__(self, flags: int, /) -> memoryview: ...\n";
+            }
+            out << "\n";
 
             // Properties
             for (const auto &member : structInfo.members) {
-                out << "    " << member.name.plain << ": " << toPythonType(member.type.plain) << "\n";
+                out << "    " << member.name.plain << ": " << types.of(member) << "\n";
             }
 
             // Member functions
             for (const auto &funcInfo : functions) {
                 if (funcInfo.parent.has_value() && funcInfo.parent->qualified == structInfo.name.qualified) {
-                    out << "    def " << funcInfo.name.plain << "(self";
+                    bool overloaded = overloads.at(qualifiedName(funcInfo)).size() > 1;
+                    out << (overloaded ? "    @overload\n" : "") << "    def " << funcInfo.name.plain << "(self";
                     if (funcInfo.hasParameters()) {
+                        bool bytes = takesBytes(funcInfo, options);
                         for (const auto &param : funcInfo.parameters) {
-                            out << ", " << param.name.plain << ": " << toPythonType(param.type.plain);
+                            out << ", " << param.name.plain << ": "
+                                << (bytes && isStringView(param) ? "Union[str, bytes, bytearray, memoryview]" : types.of(param));
                         }
                     }
-                    out << ") -> " << (funcInfo.returnType.plain.empty() ? "None" : toPythonType(funcInfo.returnType.plain)) << ": ...\n";
+                    out << ") -> " << types.resultOf(funcInfo) << ": ...\n";
+
+                    if (isAsync(funcInfo, options)) {
+                        writeAsyncStub(funcInfo, options, "    ", "self", overloaded, types, out);
+                    }
                 }
             }
             out << "\n";
         }
     }
 
-    // Rest of the function remains the same...
-    return out.str();
+    // Awaitable variants of free functions
+    for (const auto &funcInfo : functions) {
+        if (!funcInfo.isMemberFunction && isAsync(funcInfo, options)) {
+            writeAsyncStub(funcInfo, options, "", "", overloads.at(qualifiedName(funcInfo)).size() > 1, types, out);
+        }
+    }
+
+    if (options.callbackAdapters && usesCallbacks(structs, functions)) {
+        out << "def _drain_callbacks() -> int: ...\n";
+    }
+    if (options.instrument) {
+        out << "def _cppglue_stats(reset: bool = False) -> Dict[str, Dict[str, int]]: ...\n";
+    }
 }
 } // namespace
 
-void generateBindings(const Structs &structs, const Functions &functions, const Headers &headers, const std::string &moduleName,
-                      const std::filesystem::path &outputDir) {
+namespace {
+/**
+ * @brief The main source of sharded bindings: registers the classes of every shard, then their members and functions.
+ */
+void writeShardedModule(const BindingWriter &writer, const std::string &moduleName, const std::vector<BindingShard> &shards,
+                        std::ostream &out) {
+    out << "#include \"" << moduleName << "_bindings.h\"\n\n";
+    for (const auto &shard : shards) {
+        out << "void cppglue_declare_" << shard.id << "(py::module_ &m);\n"
+            << "void cppglue_define_" << shard.id << "(py::module_ &m);\n";
+    }
+
+    out << "\nPYBIND11_MODULE(" << moduleName << ", m) {\n";
+    writer.writeSetup(out);
+
+    // The classes of all shards are registered first, so signatures name classes of other scopes
+    for (const auto &shard : shards) {
+        out << "    cppglue_declare_" << shard.id << "(m);\n";
+    }
+    out << "\n";
+    for (const auto &shard : shards) {
+        out << "    cppglue_define_" << shard.id << "(m);\n";
+    }
+
+    writer.writeHelpers(out);
+    out << "}\n";
+}
+
+/**
+ * @brief Writes the outputs of generateBindings, the bindings as one source or, given shards, split into them.
+ */
+void writeModule(const Structs &structs, const Functions &functions, const Headers &headers, const std::string &moduleName,
+                 const std::filesystem::path &outputDir, const std::vector<BindingShard> *shards, const OutputSelection &outputs,
+                 const GeneratorOptions &options) {
     // Create output directory
     FileWriter::ensureDirectory(outputDir);
 
-    // Generate bindings file
-    std::stringstream bindingsContent;
-    generateBindings(structs, functions, headers, moduleName, bindingsContent);
-    FileWriter::writeIfDifferent(outputDir / (moduleName + ".cpp"), bindingsContent.str());
+    // Hashes of the previous outputs, so unchanged files are detected without reading them back
+    HashManifest manifest(outputDir);
+
+    std::vector<std::string> sources;
+    if (shards != nullptr) {
+        for (const auto &shard : *shards) {
+            sources.push_back(moduleName + "_" + shard.id + ".cpp");
+        }
+    }
+
+    // Generate bindings file, streamed straight to disk
+    if (outputs.bindings) {
+        auto          bindingsPath = outputDir / (moduleName + ".cpp");
+        StreamingFile bindings(bindingsPath, &manifest);
+        if (shards == nullptr) {
+            generateBindings(structs, functions, headers, moduleName, bindings, options);
+        } else {
+            // Includes and pickled fields are shared by the shards
+            BindingWriter     writer(structs, functions, picklableStructs(structs, options), options);
+            std::stringstream common;
+            common << "#pragma once\n\n";
+            writer.writeIncludes(common);
+            BindingWriter::writeSystemHeaders(headers, common);
+            common << "\nnamespace py = pybind11;\n";
+            FileWriter::writeIfDifferent(outputDir / (moduleName + "_bindings.h"), common.str(), &manifest);
+
+            writeShardedModule(writer, moduleName, *shards, bindings);
+            for (size_t i = 0; i < shards->size(); ++i) {
+                FileWriter::writeIfDifferent(outputDir / sources[i], (*shards)[i].code, &manifest);
+            }
+        }
+        FileWriter::commit(bindings, bindingsPath);
+
+        if (options.instrument) {
+            FileWriter::writeIfDifferent(outputDir / "cppglue_instrumentation.h",
+                                         TemplateProcessor::render<templateIndex("cppglue_instrumentation.h.template")>({}), &manifest);
+        }
+        if (options.callbackAdapters && usesCallbacks(structs, functions)) {
+            FileWriter::writeIfDifferent(outputDir / "cppglue_callbacks.h",
+                                         TemplateProcessor::render<templateIndex("cppglue_callbacks.h.template")>({}), &manifest);
+        }
+        if (usesAsync(functions, options)) {
+            FileWriter::writeIfDifferent(outputDir / "cppglue_async.h",
+                                         TemplateProcessor::render<templateIndex("cppglue_async.h.template")>({}), &manifest);
+        }
+        if (!picklableStructs(structs, options).empty()) {
+            FileWriter::writeIfDifferent(outputDir / "cppglue_pickle.h",
+                                         TemplateProcessor::render<templateIndex("cppglue_pickle.h.template")>({}), &manifest);
+        }
+        if (!bufferClasses(structs, functions, options).empty()) {
+            FileWriter::writeIfDifferent(outputDir / "cppglue_buffer.h",
+                                         TemplateProcessor::render<templateIndex("cppglue_buffer.h.template")>({}), &manifest);
+        }
+        if (usesBytes(functions, options)) {
+            FileWriter::writeIfDifferent(outputDir / "cppglue_bytes.h",
+                                         TemplateProcessor::render<templateIndex("cppglue_bytes.h.template")>({}), &manifest);
+        }
+    }
 
-    // Generate build files
-    FileWriter::writeIfDifferent(outputDir / "CMakeLists.txt", generateCMakeLists(moduleName, headers));
-    FileWriter::writeIfDifferent(outputDir / "CPM.cmake", generateCPM("0.40.5"));
+    // Generate build files, the sources of sharded bindings change with the declarations
+    if (outputs.buildFiles || (shards != nullptr && outputs.bindings)) {
+        FileWriter::writeIfDifferent(outputDir / "CMakeLists.txt", generateCMakeLists(moduleName, headers, sources, options), &manifest);
+        FileWriter::writeIfDifferent(outputDir / "CPM.cmake", generateCPM("0.40.5"), &manifest);
+    }
 
     // Create package directory
     auto packageDir = outputDir / moduleName;
     FileWriter::ensureDirectory(packageDir);
 
-    // Generate Python packaging files
-    FileWriter::writeIfDifferent(packageDir / "setup.py", generateSetupPy(moduleName));
-    FileWriter::writeIfDifferent(packageDir / "pyproject.toml", generatePyprojectToml(moduleName));
-
     // Create and populate module directory
     auto moduleDir = packageDir / moduleName;
     FileWriter::ensureDirectory(moduleDir);
 
-    // Generate __init__.py
-    std::stringstream initContent;
-    initContent << "from ." << moduleName << " import *  # type: ignore\n\n"
-                << "# Re-export all symbols defined in the .pyi stub file\n"
-                << "__all__ = []  # Will be populated by type hints from .pyi\n";
-    FileWriter::writeIfDifferent(moduleDir / "__init__.py", initContent.str());
+    if (outputs.package) {
+        // Generate Python packaging files
+        FileWriter::writeIfDifferent(packageDir / "setup.py", generateSetupPy(moduleName), &manifest);
+        FileWriter::writeIfDifferent(packageDir / "pyproject.toml", generatePyprojectToml(moduleName), &manifest);
+
+        // Generate __init__.py
+        std::stringstream initContent;
+        initContent << "from ." << moduleName << " import *  # type: ignore\n\n"
+                    << "# Re-export all symbols defined in the .pyi stub file\n"
+                    << "__all__ = []  # Will be populated by type hints from .pyi\n";
+        FileWriter::writeIfDifferent(moduleDir / "__init__.py", initContent.str(), &manifest);
+    }
 
     // Generate .pyi stub file
-    FileWriter::writeIfDifferent(moduleDir / (moduleName + ".pyi"), generatePyi(structs, functions));
+    if (outputs.stub) {
+        auto          stubPath = moduleDir / (moduleName + ".pyi");
+        StreamingFile stub(stubPath, &manifest);
+        generatePyi(structs, functions, options, stub);
+        FileWriter::commit(stub, stubPath);
+    }
 
+    manifest.save();
     std::cout << "Generated files in: " << outputDir << '\n';
 }
+} // namespace
+
+void generateBindings(const Structs &structs, const Functions &functions, const Headers &headers, const std::string &moduleName,
+                      const std::filesystem::path &outputDir, const OutputSelection &outputs, const GeneratorOptions &options) {
+    if (!options.shardBindings) {
+        writeModule(structs, functions, headers, moduleName, outputDir, nullptr, outputs, options);
+        return;
+    }
+
+    ShardPartition partition;
+    for (size_t i = 0; i < structs.size(); ++i) {
+        partition.add(structs[i], i);
+    }
+    for (size_t i = 0; i < functions.size(); ++i) {
+        partition.add(functions[i], i);
+    }
+    if (outputs.bindings) {
+        renderShards(partition, structs, functions, headers, picklableStructs(structs, options), moduleName, options);
+    }
+    writeModule(structs, functions, headers, moduleName, outputDir, &partition.shards(), outputs, options);
+}
+
+void generateShardedBindings(const Structs &structs, const Functions &functions, const Headers &headers, const std::string &moduleName,
+                             const std::filesystem::path &outputDir, const std::vector<BindingShard> &shards,
+                             const OutputSelection &outputs, const GeneratorOptions &options) {
+    writeModule(structs, functions, headers, moduleName, outputDir, &shards, outputs, options);
+}
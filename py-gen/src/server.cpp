@@ -0,0 +1,342 @@
+#include "server.h"
+
+#include "driver.h"
+
+#include <cerrno>
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <llvm/Support/raw_ostream.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+namespace {
+constexpr size_t maxRequestSize = 64 * 1024;
+
+struct Request {
+    std::filesystem::path    workingDirectory;
+    std::vector<std::string> arguments; // The client's command line without the program name
+};
+
+bool makeAddress(const std::filesystem::path &socketPath, sockaddr_un &address) {
+    const auto &path = socketPath.native();
+    if (path.size() >= sizeof(address.sun_path)) {
+        llvm::errs() << "Socket path too long: " << path << "\n";
+        return false;
+    }
+
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+bool sendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        auto sent = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(sent));
+    }
+    return true;
+}
+
+/**
+ * @brief Reads from fd until the terminator is seen (an empty terminator reads all) or the peer closes the connection.
+ */
+std::string readUntil(int fd, std::string_view terminator, size_t maxSize = maxRequestSize) {
+    std::string buffer;
+    char        chunk[4096];
+    while ((terminator.empty() || buffer.find(terminator) == std::string::npos) && buffer.size() < maxSize) {
+        auto received = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            break;
+        }
+        buffer.append(chunk, static_cast<size_t>(received));
+    }
+    return buffer;
+}
+
+std::optional<Request> parseRequest(std::string_view text) {
+    Request request;
+    while (!text.empty()) {
+        auto end  = text.find('\n');
+        auto line = text.substr(0, end);
+        text      = end == std::string_view::npos ? std::string_view{} : text.substr(end + 1);
+
+        if (line.starts_with("cwd ")) {
+            request.workingDirectory = std::string(line.substr(4));
+        } else if (line.starts_with("arg ")) {
+            request.arguments.emplace_back(line.substr(4));
+        } else if (line.empty()) {
+            break;
+        }
+    }
+
+    if (request.workingDirectory.empty()) {
+        return std::nullopt;
+    }
+    return request;
+}
+
+/**
+ * @brief Redirects stdout and stderr into temporary files while a request runs, the client prints them.
+ * Requests are handled one at a time, so the process wide redirection only ever captures one run.
+ */
+class OutputCapture {
+  public:
+    OutputCapture() {
+        flush();
+        for (int i = 0; i < 2; ++i) {
+            files_[i] = std::tmpfile();
+            saved_[i] = files_[i] != nullptr ? ::dup(descriptors[i]) : -1;
+            if (saved_[i] >= 0) {
+                ::dup2(::fileno(files_[i]), descriptors[i]);
+            }
+        }
+    }
+
+    ~OutputCapture() {
+        restore();
+        for (auto *file : files_) {
+            if (file != nullptr) {
+                std::fclose(file);
+            }
+        }
+    }
+
+    OutputCapture(const OutputCapture &)            = delete;
+    OutputCapture &operator=(const OutputCapture &) = delete;
+
+    /**
+     * @brief Ends the redirection and returns what was written to stdout (0) and stderr (1).
+     */
+    std::array<std::string, 2> finish() {
+        restore();
+        std::array<std::string, 2> output;
+        for (int i = 0; i < 2; ++i) {
+            if (files_[i] == nullptr) {
+                continue;
+            }
+            std::rewind(files_[i]);
+            char   chunk[4096];
+            size_t read = 0;
+            while ((read = std::fread(chunk, 1, sizeof(chunk), files_[i])) > 0) {
+                output[i].append(chunk, read);
+            }
+        }
+        return output;
+    }
+
+  private:
+    static constexpr int descriptors[2] = {STDOUT_FILENO, STDERR_FILENO};
+
+    static void flush() {
+        llvm::outs().flush();
+        llvm::errs().flush();
+        std::cout.flush();
+        std::cerr.flush();
+        std::fflush(nullptr);
+    }
+
+    void restore() {
+        flush();
+        for (int i = 0; i < 2; ++i) {
+            if (saved_[i] >= 0) {
+                ::dup2(saved_[i], descriptors[i]);
+                ::close(saved_[i]);
+                saved_[i] = -1;
+            }
+        }
+    }
+
+    std::FILE *files_[2]{};
+    int        saved_[2]{-1, -1};
+};
+
+int handleRequest(const Request &request, ExtractionSession &session) {
+    // Relative paths in the arguments and the config (sources, output_dir) are relative to the client, like a local run
+    auto previousDirectory = std::filesystem::current_path();
+
+    int exitCode = 1;
+    try {
+        std::filesystem::current_path(request.workingDirectory);
+
+        // Parsed exactly like a local run, so the command line overrides of the config apply as well
+        std::vector<const char *> argv{"py-gen"};
+        for (const auto &argument : request.arguments) {
+            argv.push_back(argument.c_str());
+        }
+
+        ProgramOptions options;
+        if (!processCLIargsIntoProgramOptions(static_cast<int>(argv.size()), argv.data(), options)) {
+            llvm::errs() << "Error parsing command line options\n";
+        } else if (!options.serveSocket.empty() || options.watch || options.merge || options.shardCount > 1) {
+            llvm::errs() << "--serve, --watch, --shard and merge are not handled by the server\n";
+        } else if (parseToml(options.configFile, options)) {
+            exitCode = runGenerator(options, session);
+        }
+    } catch (const std::exception &e) {
+        llvm::errs() << "Error handling request from " << request.workingDirectory.string() << ": " << e.what() << "\n";
+    }
+
+    std::error_code ec;
+    std::filesystem::current_path(previousDirectory, ec);
+    return exitCode;
+}
+
+std::string makeReply(const std::string &out, const std::string &err, int exitCode) {
+    return "stdout " + std::to_string(out.size()) + "\n" + out + "stderr " + std::to_string(err.size()) + "\n" + err + "exit " +
+           std::to_string(exitCode) + "\n";
+}
+
+/**
+ * @brief Reads one `<name> <size>\n<data>` section of a reply.
+ */
+std::optional<std::string_view> replySection(std::string_view &reply, std::string_view name) {
+    auto end = reply.find('\n');
+    if (end == std::string_view::npos || !reply.starts_with(name) || reply.size() <= name.size() || reply[name.size()] != ' ') {
+        return std::nullopt;
+    }
+    size_t size = 0;
+    auto   text = reply.substr(name.size() + 1, end - name.size() - 1);
+    if (std::from_chars(text.data(), text.data() + text.size(), size).ec != std::errc{} || reply.size() - end - 1 < size) {
+        return std::nullopt;
+    }
+    auto data = reply.substr(end + 1, size);
+    reply.remove_prefix(end + 1 + size);
+    return data;
+}
+} // namespace
+
+int runServer(const std::filesystem::path &socketPath) {
+    sockaddr_un address{};
+    if (!makeAddress(socketPath, address)) {
+        return 1;
+    }
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        llvm::errs() << "Failed to create socket: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    ::unlink(address.sun_path);
+    if (::bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 || ::listen(listener, 16) != 0) {
+        llvm::errs() << "Failed to listen on " << socketPath.string() << ": " << std::strerror(errno) << "\n";
+        ::close(listener);
+        return 1;
+    }
+
+    llvm::outs() << "py-gen server listening on " << socketPath.string() << "\n";
+    llvm::outs().flush();
+
+    ExtractionSession session;
+    for (;;) {
+        int client = ::accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            llvm::errs() << "Failed to accept connection: " << std::strerror(errno) << "\n";
+            break;
+        }
+
+        auto request = parseRequest(readUntil(client, "\n\n"));
+        if (!request) {
+            llvm::errs() << "Malformed request\n";
+            sendAll(client, makeReply("", "Malformed request\n", 1));
+            ::close(client);
+            continue;
+        }
+
+        OutputCapture capture;
+        int           exitCode = handleRequest(*request, session);
+        auto [out, err]        = capture.finish();
+
+        llvm::outs() << "Handled request from " << request->workingDirectory.string() << ": exit " << exitCode << "\n";
+        llvm::outs().flush();
+        sendAll(client, makeReply(out, err, exitCode));
+        ::close(client);
+    }
+
+    ::close(listener);
+    ::unlink(address.sun_path);
+    return 1;
+}
+
+std::optional<int> forwardToServer(const std::filesystem::path &socketPath, int argc, const char **argv) {
+    sockaddr_un address{};
+    if (!makeAddress(socketPath, address)) {
+        return std::nullopt;
+    }
+
+    // One argument per line, an argument spanning lines can only be run locally
+    auto request = "cwd " + std::filesystem::current_path().string() + "\n";
+    for (int i = 1; i < argc; ++i) {
+        std::string_view argument = argv[i];
+        if (argument.find('\n') != std::string_view::npos) {
+            return std::nullopt;
+        }
+        request += "arg ";
+        request += argument;
+        request += '\n';
+    }
+    request += '\n';
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    if (!sendAll(fd, request)) {
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    // The server closes the connection after the reply
+    auto reply = readUntil(fd, "", std::string::npos);
+    ::close(fd);
+
+    std::string_view rest = reply;
+    auto             out  = replySection(rest, "stdout");
+    auto             err  = out ? replySection(rest, "stderr") : std::nullopt;
+    if (!err || !rest.starts_with("exit ")) {
+        llvm::errs() << "Unexpected reply from py-gen server: " << reply << "\n";
+        return 1;
+    }
+    llvm::outs() << *out;
+    llvm::errs() << *err;
+    return std::atoi(rest.data() + 5);
+}
+#else
+int runServer(const std::filesystem::path &) {
+    llvm::errs() << "Server mode is not supported on this platform\n";
+    return 1;
+}
+
+std::optional<int> forwardToServer(const std::filesystem::path &, int, const char **) { return std::nullopt; }
+#endif
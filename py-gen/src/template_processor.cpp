@@ -0,0 +1,48 @@
+#include "template_processor.h"
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+void TemplateProcessor::setOverrideDirectory(std::filesystem::path directory) { overrideDirectory_ = std::move(directory); }
+
+std::string TemplateProcessor::renderText(std::string_view text, const TemplateArguments &arguments) {
+    std::vector<TemplateSlot> slots;
+    forEachPlaceholder(text, [&slots](const TemplateSlot &slot) { slots.push_back(slot); });
+    return splice(text, slots, arguments);
+}
+
+std::string TemplateProcessor::splice(std::string_view text, std::span<const TemplateSlot> slots, const TemplateArguments &arguments) {
+    size_t size = text.size();
+    for (const auto &slot : slots) {
+        size = size - slot.length + arguments[slot.parameter].size();
+    }
+
+    std::string result;
+    result.reserve(size);
+
+    size_t pos = 0;
+    for (const auto &slot : slots) {
+        result.append(text, pos, slot.offset - pos);
+        result.append(arguments[slot.parameter]);
+        pos = slot.offset + slot.length;
+    }
+    result.append(text, pos);
+    return result;
+}
+
+std::optional<std::string> TemplateProcessor::readOverride(std::string_view name) {
+    if (overrideDirectory_.empty()) {
+        return std::nullopt;
+    }
+
+    auto          path = overrideDirectory_ / name;
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return std::nullopt;
+    }
+
+    std::cout << "Using template: " << path << '\n';
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
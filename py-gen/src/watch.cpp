@@ -0,0 +1,314 @@
+#include "watch.h"
+
+#include "driver.h"
+#include "ir_collector.hpp"
+#include "module_selector.h"
+#include "py-gen.h"
+#include "template_processor.h"
+
+#include <cerrno>
+#include <cstring>
+#include <llvm/Support/raw_ostream.h>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+namespace {
+// Editors often save in several steps (truncate, write, rename), collect events for a short while before re-extracting
+constexpr int debounceMilliseconds = 100;
+
+struct TranslationUnit {
+    Structs   structs;
+    Functions functions;
+    Headers   headers;
+};
+
+std::string normalize(const std::filesystem::path &path) {
+    std::error_code ec;
+    auto            canonical = std::filesystem::weakly_canonical(std::filesystem::absolute(path), ec);
+    return ec ? path.string() : canonical.string();
+}
+
+Headers directHeaders(const Headers &headers) {
+    Headers direct;
+    for (const auto &header : headers) {
+        if (header.isDirect) {
+            direct.push_back(header);
+        }
+    }
+    return direct;
+}
+
+class Watcher {
+  public:
+    explicit Watcher(const ProgramOptions &options) : options_(options) {}
+
+    ~Watcher() {
+        if (inotify_ >= 0) {
+            ::close(inotify_);
+        }
+    }
+
+    int run() {
+        if (options_.sources.empty()) {
+            llvm::errs() << "Watch mode needs the sources listed in the config\n";
+            return 1;
+        }
+
+        inotify_ = ::inotify_init1(IN_CLOEXEC);
+        if (inotify_ < 0) {
+            llvm::errs() << "Failed to initialize inotify: " << std::strerror(errno) << "\n";
+            return 1;
+        }
+
+        TemplateProcessor::setOverrideDirectory(options_.templateDir);
+
+        for (const auto &source : options_.sources) {
+            extract(source);
+        }
+        if (!options_.instantiations.empty()) {
+            extract(instantiationUnit);
+        }
+        emit(true);
+
+        for (;;) {
+            updateWatches();
+            llvm::outs() << "Watching " << dependents_.size() << " files for changes\n";
+            llvm::outs().flush();
+
+            auto changed = waitForChanges();
+            if (!changed) {
+                return 1;
+            }
+
+            std::set<std::string> affected;
+            for (const auto &file : *changed) {
+                const auto &sources = dependents_[file];
+                affected.insert(sources.begin(), sources.end());
+            }
+
+            if (affected.empty()) {
+                continue;
+            }
+
+            // The reported files may still be cached with their old contents, whatever their status says now
+            session_.reset(makeExtractionRequest(options_).workingDirectory);
+            for (const auto &source : affected) {
+                llvm::outs() << "Re-extracting: " << source << "\n";
+                extract(source);
+            }
+            emit(false);
+        }
+    }
+
+  private:
+    /**
+     * @brief Extracts one translation unit and records which files it depends on.
+     * On failure (e.g. a header saved halfway through an edit) the previous results are kept.
+     * The instantiations are a unit of their own, re-extracted when a header they include changes.
+     */
+    void extract(const std::string &source) {
+        TranslationUnit unit;
+
+        auto cb = [&unit](Structs &&structs, Functions &&functions) {
+            unit.structs.insert(unit.structs.end(), std::make_move_iterator(structs.begin()), std::make_move_iterator(structs.end()));
+            unit.functions.insert(unit.functions.end(), std::make_move_iterator(functions.begin()),
+                                  std::make_move_iterator(functions.end()));
+        };
+
+        auto hcb = [&unit](Headers &&headers) {
+            unit.headers.insert(unit.headers.end(), std::make_move_iterator(headers.begin()), std::make_move_iterator(headers.end()));
+        };
+
+        auto request = makeExtractionRequest(options_);
+        if (source == instantiationUnit) {
+            request.instantiationsOnly = true;
+        } else {
+            request.sources = {source};
+            request.instantiations.clear();
+        }
+
+        if (session_.run(request, cb, hcb) != 0) {
+            llvm::errs() << "Error extracting " << source << ", keeping previous results\n";
+            // Still watch the source itself so fixing it triggers a new run
+            if (source != instantiationUnit) {
+                dependents_[normalize(source)].insert(source);
+            }
+            return;
+        }
+
+        for (auto &[file, sources] : dependents_) {
+            sources.erase(source);
+        }
+
+        if (source != instantiationUnit) {
+            dependents_[normalize(source)].insert(source);
+        }
+        for (const auto &header : unit.headers) {
+            if (!header.isSystem && !header.fullPath.empty()) {
+                dependents_[normalize(header.fullPath)].insert(source);
+            }
+        }
+
+        units_.insert_or_assign(source, std::move(unit));
+    }
+
+    /**
+     * @brief Merges all translation units (in config order) and regenerates the outputs of each module whose inputs changed.
+     */
+    void emit(bool initial) {
+        IRCollector collector;
+        auto        sources = options_.sources;
+        sources.push_back(instantiationUnit);
+        for (const auto &source : sources) {
+            auto it = units_.find(source);
+            if (it == units_.end()) {
+                continue;
+            }
+            const auto &unit = it->second;
+            collector.addDeclarations(Structs(unit.structs), Functions(unit.functions));
+            collector.addHeaders(Headers(unit.headers));
+        }
+        auto [structs, functions, headers] = collector.take();
+
+        bool headersChanged = initial || directHeaders(headers) != directHeaders(headers_);
+
+        generated_.resize(options_.modules.size());
+        for (size_t i = 0; i < options_.modules.size(); ++i) {
+            const auto &module    = options_.modules[i];
+            auto       &generated = generated_[i];
+
+            auto [moduleStructs, moduleFunctions] = selectForModule(structs, functions, module.selector);
+
+            OutputSelection outputs;
+            if (!initial) {
+                bool declarationsChanged = moduleStructs != generated.structs || moduleFunctions != generated.functions;
+
+                outputs = {.bindings   = declarationsChanged || headersChanged,
+                           .buildFiles = headersChanged,
+                           .package    = false,
+                           .stub       = declarationsChanged};
+
+                if (!outputs.bindings) {
+                    llvm::outs() << "No changes in declarations of " << module.moduleName << ", outputs are up to date\n";
+                    continue;
+                }
+            }
+
+            generateBindings(moduleStructs, moduleFunctions, headers, module.moduleName, module.outputDir, outputs, options_.generator);
+
+            generated.structs   = std::move(moduleStructs);
+            generated.functions = std::move(moduleFunctions);
+        }
+
+        headers_ = std::move(headers);
+    }
+
+    /**
+     * @brief Watches the directories of all dependencies, watching files directly would miss editors that save by rename.
+     */
+    void updateWatches() {
+        for (const auto &[file, sources] : dependents_) {
+            auto directory = std::filesystem::path(file).parent_path();
+            if (watchedDirectories_.contains(directory)) {
+                continue;
+            }
+
+            int wd = ::inotify_add_watch(inotify_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+            if (wd < 0) {
+                llvm::errs() << "Failed to watch " << directory.string() << ": " << std::strerror(errno) << "\n";
+                continue;
+            }
+            watchedDirectories_.insert(directory);
+            watchDescriptors_[wd] = directory;
+        }
+    }
+
+    /**
+     * @brief Blocks until at least one inotify event arrived, then collects events until the debounce window passed.
+     * @return The dependencies that changed (possibly none), or std::nullopt on error
+     */
+    std::optional<std::set<std::string>> waitForChanges() {
+        std::set<std::string> changed;
+
+        alignas(inotify_event) char buffer[64 * 1024];
+        int timeout = -1;
+        for (;;) {
+            pollfd descriptor{.fd = inotify_, .events = POLLIN, .revents = 0};
+            int    ready = ::poll(&descriptor, 1, timeout);
+            if (ready < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                llvm::errs() << "Failed waiting for file changes: " << std::strerror(errno) << "\n";
+                return std::nullopt;
+            }
+
+            if (ready == 0) {
+                return changed;
+            }
+
+            auto length = ::read(inotify_, buffer, sizeof(buffer));
+            if (length <= 0) {
+                llvm::errs() << "Failed reading file changes: " << std::strerror(errno) << "\n";
+                return std::nullopt;
+            }
+
+            for (char *ptr = buffer; ptr < buffer + length;) {
+                const auto *event = reinterpret_cast<const inotify_event *>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+
+                auto it = watchDescriptors_.find(event->wd);
+                if (event->len == 0 || it == watchDescriptors_.end()) {
+                    continue;
+                }
+
+                auto path = (it->second / event->name).string();
+                if (dependents_.contains(path)) {
+                    changed.insert(path);
+                }
+            }
+            timeout = debounceMilliseconds;
+        }
+    }
+
+    const ProgramOptions &options_;
+    ExtractionSession     session_;
+
+    static constexpr const char *instantiationUnit = "<instantiations>"; // Key of the instantiations in units_
+
+    std::map<std::string, TranslationUnit>       units_;      // Keyed by the source as given in the config
+    std::map<std::string, std::set<std::string>> dependents_; // Normalized file path -> sources including it
+
+    // Last generated inputs, to decide which outputs need regenerating
+    struct GeneratedModule {
+        Structs   structs;
+        Functions functions;
+    };
+    std::vector<GeneratedModule> generated_; // One per module in options_.modules
+    Headers                      headers_;
+
+    int                                  inotify_{-1};
+    std::set<std::filesystem::path>      watchedDirectories_;
+    std::map<int, std::filesystem::path> watchDescriptors_;
+};
+} // namespace
+
+int runWatch(const ProgramOptions &options) {
+    Watcher watcher(options);
+    return watcher.run();
+}
+#else
+int runWatch(const ProgramOptions &) {
+    llvm::errs() << "Watch mode is not supported on this platform\n";
+    return 1;
+}
+#endif
@@ -0,0 +1,89 @@
+#include "py-gen.h"
+
+#include <doctest/doctest.h>
+#include <string>
+
+namespace {
+TypeIndex intern(TypeInfo::Kind kind, const std::string &spelling, const std::string &name = {}, std::vector<TypeIndex> arguments = {},
+                 TypeIndex element = noType) {
+    TypeInfo info;
+    info.kind      = kind;
+    info.spelling  = spelling;
+    info.name      = name;
+    info.arguments = std::move(arguments);
+    info.element   = element;
+    return TypeTable::shared().intern(std::move(info));
+}
+
+FieldDeclarationInfo field(const std::string &name, TypeIndex type, bool isPublic = true) {
+    FieldDeclarationInfo info;
+    info.name.plain     = name;
+    info.name.qualified = name;
+    info.type.plain     = TypeTable::shared()[type].spelling;
+    info.type.qualified = TypeTable::shared()[type].spelling;
+    info.isPublic       = isPublic;
+    info.typeIndex      = type;
+    return info;
+}
+
+StructInfo record(const std::string &name, std::vector<FieldDeclarationInfo> members) {
+    StructInfo info;
+    info.name.plain     = name.substr(name.rfind(':') + 1);
+    info.name.qualified = name;
+    info.members        = std::move(members);
+    return info;
+}
+
+TypeIndex doubles() {
+    auto element = intern(TypeInfo::Kind::Floating, "double");
+    return intern(TypeInfo::Kind::Record, "std::vector<double, std::allocator<double>>", "std::vector",
+                  {element, intern(TypeInfo::Kind::Record, "std::allocator<double>", "std::allocator")});
+}
+
+GeneratorOptions detecting() {
+    GeneratorOptions options;
+    options.bufferProtocol = true;
+    return options;
+}
+} // namespace
+
+TEST_CASE("A public container of numbers as the only field is detected") {
+    auto    rgb = intern(TypeInfo::Kind::Array, "int[3]", {}, {}, intern(TypeInfo::Kind::Integer, "int"));
+    Structs structs{record("alpha::Samples", {field("values", doubles())}), record("alpha::Color", {field("rgb", rgb)})};
+
+    auto buffers = bufferClasses(structs, {}, detecting());
+    CHECK(buffers == Buffers{{"alpha::Color", {.data = "std::data(self.rgb)", .extents = {"std::size(self.rgb)"}}},
+                             {"alpha::Samples", {.data = "std::data(self.values)", .extents = {"std::size(self.values)"}}}});
+    CHECK(bufferClasses(structs, {}, GeneratorOptions{}).empty());
+}
+
+TEST_CASE("Containers next to other fields or not public are not detected") {
+    auto integer = intern(TypeInfo::Kind::Integer, "int");
+    auto name    = intern(TypeInfo::Kind::Record, "std::basic_string<char, std::char_traits<char>, std::allocator<char>>",
+                          "std::basic_string");
+    auto flags   = intern(TypeInfo::Kind::Record, "std::vector<_Bool>", "std::vector", {intern(TypeInfo::Kind::Bool, "_Bool")});
+
+    // The other fields were inherited or filtered out
+    auto derived         = record("alpha::Derived", {field("values", doubles())});
+    derived.hasAllFields = false;
+
+    Structs structs{record("alpha::Polygon", {field("name", name), field("xs", doubles()), field("id", integer)}),
+                    record("alpha::Hidden", {field("values", doubles(), false)}), record("alpha::Flags", {field("bits", flags)}),
+                    derived};
+
+    CHECK(bufferClasses(structs, {}, detecting()).empty());
+}
+
+TEST_CASE("Configured layouts name public members only") {
+    auto integer = intern(TypeInfo::Kind::Integer, "int");
+
+    Structs structs{record("alpha::Polygon", {field("xs", doubles()), field("id", integer)}),
+                    record("alpha::Image", {field("pixels", doubles(), false), field("width", integer), field("height", integer)})};
+
+    GeneratorOptions options;
+    options.buffers = {{.className = "alpha::Polygon", .data = "xs", .size = {}, .shape = {}},
+                       {.className = "alpha::Image", .data = "pixels", .size = {}, .shape = {"height", "width"}}};
+
+    CHECK(bufferClasses(structs, {}, options) ==
+          Buffers{{"alpha::Polygon", {.data = "std::data(self.xs)", .extents = {"std::size(self.xs)"}}}});
+}
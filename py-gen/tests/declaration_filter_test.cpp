@@ -0,0 +1,118 @@
+#include "declaration_filter.hpp"
+
+#include <doctest/doctest.h>
+#include <regex>
+#include <string>
+
+namespace {
+bool globMatches(const std::string &glob, char separator, const std::string &text) {
+    return std::regex_match(text, std::regex(globToRegexPattern(glob, separator)));
+}
+} // namespace
+
+TEST_CASE("globToRegexPattern keeps * and ? within one segment and lets ** cross") {
+    CHECK(globMatches("alpha::*", ':', "alpha::Point"));
+    CHECK_FALSE(globMatches("alpha::*", ':', "alpha::detail::Point"));
+    CHECK(globMatches("alpha::**", ':', "alpha::detail::Point"));
+    CHECK(globMatches("alpha::P?int", ':', "alpha::Point"));
+    CHECK_FALSE(globMatches("alpha::P?int", ':', "alpha::P:int"));
+
+    CHECK(globMatches("**/include/*.h", '/', "/src/project/include/point.h"));
+    CHECK_FALSE(globMatches("**/include/*.h", '/', "/src/project/include/detail/point.h"));
+}
+
+TEST_CASE("globToRegexPattern escapes regex syntax") {
+    CHECK(globMatches("point.h", '/', "point.h"));
+    CHECK_FALSE(globMatches("point.h", '/', "pointxh"));
+    CHECK(globMatches("ops::operator()", ':', "ops::operator()"));
+    CHECK(globMatches("a+b[1]{2}$^|\\", '/', "a+b[1]{2}$^|\\"));
+}
+
+TEST_CASE("The most specific namespace rule wins") {
+    DeclarationFilterRules rules;
+    rules.includeNamespaces = {"alpha", "alpha::detail::keep"};
+    rules.excludeNamespaces = {"alpha::detail"};
+    DeclarationFilter filter(rules);
+
+    CHECK(filter.accepts("alpha::Point", ""));
+    CHECK(filter.accepts("alpha::inner::Point", ""));
+    CHECK_FALSE(filter.accepts("alpha::detail::Helper", ""));
+    CHECK(filter.accepts("alpha::detail::keep::Helper", ""));
+    // Scopes are compared by segment, not by prefix
+    CHECK(filter.accepts("alpha::detail_v2::Helper", ""));
+    // Include rules exist, so everything outside of them is excluded
+    CHECK_FALSE(filter.accepts("beta::Point", ""));
+    CHECK_FALSE(filter.accepts("alphabet::Point", ""));
+}
+
+TEST_CASE("Without include rules only the excluded namespaces are dropped") {
+    DeclarationFilterRules rules;
+    rules.excludeNamespaces = {"alpha::detail"};
+    DeclarationFilter filter(rules);
+
+    CHECK(filter.accepts("alpha::Point", ""));
+    CHECK(filter.accepts("beta::Point", ""));
+    CHECK(filter.accepts("Point", ""));
+    CHECK_FALSE(filter.accepts("alpha::detail::Helper", ""));
+}
+
+TEST_CASE("prunesScope only prunes scopes that contain nothing selectable") {
+    DeclarationFilterRules rules;
+    rules.includeNamespaces = {"alpha::api"};
+    rules.excludeNamespaces = {"alpha::api::detail"};
+    DeclarationFilter filter(rules);
+
+    // alpha itself is not included, but it contains alpha::api
+    CHECK_FALSE(filter.prunesScope("alpha"));
+    CHECK_FALSE(filter.prunesScope("alpha::api"));
+    CHECK_FALSE(filter.prunesScope("alpha::api::inner"));
+    CHECK(filter.prunesScope("alpha::api::detail"));
+    CHECK(filter.prunesScope("alpha::other"));
+    CHECK(filter.prunesScope("beta"));
+
+    rules.includeNamespaces = {"alpha::detail::keep"};
+    rules.excludeNamespaces = {"alpha::detail"};
+    DeclarationFilter reincluded(rules);
+    CHECK_FALSE(reincluded.prunesScope("alpha::detail"));
+    CHECK(reincluded.prunesScope("alpha::detail::other"));
+
+    DeclarationFilter empty(DeclarationFilterRules{});
+    CHECK_FALSE(empty.prunesScope("alpha"));
+}
+
+TEST_CASE("Name, regex and header rules") {
+    DeclarationFilterRules rules;
+    rules.includeNames   = {"alpha::*"};
+    rules.excludeNames   = {"*::impl_*"};
+    rules.excludeRegexes = {"Internal$"};
+    rules.includeHeaders = {"**/include/**"};
+    rules.excludeHeaders = {"**/generated/*.h"};
+    DeclarationFilter filter(rules);
+
+    CHECK(filter.accepts("alpha::Point", "/p/include/point.h"));
+    CHECK_FALSE(filter.accepts("alpha::inner::Point", "/p/include/point.h"));
+    CHECK_FALSE(filter.accepts("alpha::impl_Point", "/p/include/point.h"));
+    CHECK_FALSE(filter.accepts("alpha::PointInternal", "/p/include/point.h"));
+    CHECK_FALSE(filter.accepts("alpha::Point", "/p/src/point.h"));
+    CHECK_FALSE(filter.accepts("alpha::Point", "/p/include/generated/point.h"));
+    CHECK(filter.accepts("alpha::Point", "/p/include/generated/sub/point.h"));
+}
+
+TEST_CASE("Invalid regexes are reported when the filter is compiled") {
+    DeclarationFilterRules rules;
+    rules.includeRegexes = {"alpha::("};
+    CHECK_THROWS_AS(DeclarationFilter(rules), std::regex_error);
+}
+
+TEST_CASE("publicOnly skips private and protected members") {
+    DeclarationFilterRules rules;
+    DeclarationFilter      all(rules);
+    rules.publicOnly = true;
+    DeclarationFilter publicOnly(rules);
+
+    CHECK(all.acceptsAccess(clang::AS_private));
+    CHECK(publicOnly.acceptsAccess(clang::AS_public));
+    CHECK(publicOnly.acceptsAccess(clang::AS_none));
+    CHECK_FALSE(publicOnly.acceptsAccess(clang::AS_protected));
+    CHECK_FALSE(publicOnly.acceptsAccess(clang::AS_private));
+}
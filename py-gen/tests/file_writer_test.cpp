@@ -0,0 +1,150 @@
+#include "file_writer.h"
+#include "temporary_directory.h"
+
+#include <chrono>
+#include <doctest/doctest.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace {
+bool generate(const std::filesystem::path &path, const std::string &content, HashManifest *manifest = nullptr) {
+    StreamingFile file(path, manifest);
+    file << content;
+    return file.commit();
+}
+
+void writeByHand(const std::filesystem::path &path, const std::string &content) {
+    std::ofstream(path, std::ios::binary) << content;
+}
+
+std::string read(const std::filesystem::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+// An mtime clearly apart from now, so a rewrite shows even on file systems with coarse timestamps
+std::filesystem::file_time_type backdate(const std::filesystem::path &path) {
+    auto time = std::filesystem::last_write_time(path) - std::chrono::hours(1);
+    std::filesystem::last_write_time(path, time);
+    return time;
+}
+
+// Several chunks of the 64 KiB buffer
+std::string largeContent() {
+    std::string content;
+    for (size_t i = 0; content.size() < 3 * 64 * 1024 + 100; ++i) {
+        content += "line " + std::to_string(i) + "\n";
+    }
+    return content;
+}
+} // namespace
+
+TEST_CASE("An unchanged file keeps its modification time") {
+    TemporaryDirectory directory;
+    auto               path = directory.path() / "module.cpp";
+
+    CHECK(generate(path, "content\n"));
+    auto modified = backdate(path);
+
+    CHECK_FALSE(generate(path, "content\n"));
+    CHECK(std::filesystem::last_write_time(path) == modified);
+    CHECK(directory.fileCount() == 1);
+}
+
+TEST_CASE("Output that is a strict prefix of the existing file replaces it") {
+    TemporaryDirectory directory;
+    auto               path = directory.path() / "module.cpp";
+
+    writeByHand(path, "abcdef");
+    CHECK(generate(path, "abc"));
+    CHECK(read(path) == "abc");
+
+    CHECK(generate(path, "abcdef"));
+    CHECK(read(path) == "abcdef");
+
+    CHECK(generate(path, ""));
+    CHECK(read(path).empty());
+    CHECK(directory.fileCount() == 1);
+}
+
+TEST_CASE("A difference in the first or the last chunk is written") {
+    TemporaryDirectory directory;
+    auto               path    = directory.path() / "module.cpp";
+    auto               content = largeContent();
+
+    CHECK(generate(path, content));
+    CHECK_FALSE(generate(path, content));
+
+    auto first = content;
+    first[0]   = 'L';
+    CHECK(generate(path, first));
+    CHECK(read(path) == first);
+
+    auto last   = content;
+    last.back() = '!';
+    CHECK(generate(path, last));
+    CHECK(read(path) == last);
+
+    CHECK(directory.fileCount() == 1);
+}
+
+TEST_CASE("A manifest entry is trusted while size and modification time match") {
+    TemporaryDirectory directory;
+    auto               path    = directory.path() / "module.cpp";
+    auto               content = largeContent();
+
+    {
+        HashManifest manifest(directory.path());
+        CHECK(generate(path, content, &manifest));
+        manifest.save();
+    }
+
+    HashManifest manifest(directory.path());
+    REQUIRE(manifest.lookup(path).has_value());
+    CHECK(manifest.lookup(path)->size == content.size());
+
+    auto modified = std::filesystem::last_write_time(path);
+    CHECK_FALSE(generate(path, content, &manifest));
+    CHECK(std::filesystem::last_write_time(path) == modified);
+
+    CHECK(generate(path, content + "more\n", &manifest));
+    CHECK(read(path) == content + "more\n");
+}
+
+TEST_CASE("A stale manifest entry falls back to comparing the file") {
+    TemporaryDirectory directory;
+    auto               path = directory.path() / "module.cpp";
+
+    {
+        HashManifest manifest(directory.path());
+        CHECK(generate(path, "generated\n", &manifest));
+        manifest.save();
+    }
+
+    // Edited by hand, same size, so only the modification time tells
+    writeByHand(path, "edited!!!\n");
+    backdate(path);
+
+    HashManifest manifest(directory.path());
+    CHECK_FALSE(manifest.lookup(path).has_value());
+    CHECK(generate(path, "generated\n", &manifest));
+    CHECK(read(path) == "generated\n");
+
+    // The rewrite recorded a new entry
+    CHECK(manifest.lookup(path).has_value());
+}
+
+TEST_CASE("A stream discarded without commit leaves the existing file") {
+    TemporaryDirectory directory;
+    auto               path = directory.path() / "module.cpp";
+
+    writeByHand(path, "existing\n");
+    {
+        StreamingFile file(path);
+        file << largeContent();
+    }
+    CHECK(read(path) == "existing\n");
+    CHECK(directory.fileCount() == 1);
+}
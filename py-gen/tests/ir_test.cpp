@@ -0,0 +1,253 @@
+#include "driver.h"
+#include "ir_collector.hpp"
+#include "ir_export.hpp"
+#include "ir_import.hpp"
+#include "temporary_directory.h"
+
+#include <doctest/doctest.h>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+TypeIndex intern(TypeInfo::Kind kind, const std::string &spelling, const std::string &name = {},
+                 std::vector<TypeIndex> arguments = {}) {
+    TypeInfo info;
+    info.kind      = kind;
+    info.spelling  = spelling;
+    info.name      = name;
+    info.arguments = std::move(arguments);
+    return TypeTable::shared().intern(std::move(info));
+}
+
+DeclarationName name(const std::string &qualified, std::optional<std::string> namespace_ = "alpha") {
+    return {.plain = qualified.substr(qualified.rfind(':') + 1), .qualified = qualified, .namespace_ = std::move(namespace_)};
+}
+
+FieldDeclarationInfo field(const std::string &fieldName, const std::string &type, TypeIndex typeIndex) {
+    FieldDeclarationInfo info;
+    info.type      = name(type, std::nullopt);
+    info.name      = name(fieldName, std::nullopt);
+    info.isPublic  = true;
+    info.typeIndex = typeIndex;
+    return info;
+}
+
+StructInfo point() {
+    StructInfo info;
+    info.name         = name("alpha::Point");
+    info.definingFile = "/src/alpha/point.h";
+    info.isAggregate  = true;
+    auto tags         = intern(TypeInfo::Kind::Record, "std::vector<int>", "std::vector", {intern(TypeInfo::Kind::Integer, "int")});
+    info.members      = {field("x", "double", intern(TypeInfo::Kind::Floating, "double")), field("tags", "std::vector<int>", tags)};
+    return info;
+}
+
+StructInfo color() {
+    StructInfo info;
+    info.name         = name("alpha::Color");
+    info.isEnum       = true;
+    info.definingFile = "/src/alpha/color.h";
+    auto red          = field("alpha::Color::Red", "", noType);
+    red.value         = -1;
+    auto blue         = field("alpha::Color::Blue", "", noType);
+    blue.value        = int64_t{1} << 40;
+    info.members      = {red, blue};
+    return info;
+}
+
+FunctionInfo length(bool isConst = true) {
+    FunctionInfo function;
+    function.name             = name("alpha::Point::length");
+    function.returnType       = name("double", std::nullopt);
+    function.returnTypeIndex  = intern(TypeInfo::Kind::Floating, "double");
+    function.isMemberFunction = true;
+    function.isConst          = isConst;
+    function.parent           = name("alpha::Point");
+    function.definingFile     = "/src/alpha/point.h";
+    function.parameters       = {field("scale", "double", intern(TypeInfo::Kind::Floating, "double"))};
+    return function;
+}
+
+Header header(const std::string &fileName) {
+    return {.name = fileName, .fullPath = "/src/alpha/" + fileName, .isSystem = false, .isInputFile = true, .isDirect = true};
+}
+
+CollectedIR exportAndImport(const std::string &path, IRFormat format) {
+    {
+        IRExporter exporter(path, format);
+        exporter.addDeclarations({point(), color()}, {length()});
+        exporter.addHeaders({header("point.h"), header("color.h")});
+    }
+
+    CollectedIR ir;
+    IRImporter::read(
+        path,
+        [&ir](Structs &&structs, Functions &&functions) {
+            ir.structs.insert(ir.structs.end(), structs.begin(), structs.end());
+            ir.functions.insert(ir.functions.end(), functions.begin(), functions.end());
+        },
+        [&ir](Headers &&headers) { ir.headers.insert(ir.headers.end(), headers.begin(), headers.end()); });
+    return ir;
+}
+
+void writeShard(const std::string &path, std::optional<ShardInfo> shard, IRFormat format = IRFormat::Json) {
+    IRExporter exporter(path, format, shard);
+    exporter.addDeclarations({point()}, {});
+}
+
+void writeByHand(const std::string &path, const std::string &content) { std::ofstream(path, std::ios::binary) << content; }
+
+ProgramOptions mergeOf(std::vector<std::string> inputs) {
+    ProgramOptions options;
+    options.merge       = true;
+    options.mergeInputs = std::move(inputs);
+    return options;
+}
+} // namespace
+
+TEST_CASE("IR survives a JSON and a MessagePack round trip") {
+    TemporaryDirectory directory;
+
+    for (auto format : {IRFormat::Json, IRFormat::MessagePack}) {
+        auto ir = exportAndImport((directory.path() / "ir").string(), format);
+        CHECK(ir.structs == Structs{point(), color()});
+        CHECK(ir.functions == Functions{length()});
+        CHECK(ir.headers == Headers{header("point.h"), header("color.h")});
+    }
+}
+
+TEST_CASE("MessagePack keeps values that need the wide encodings") {
+    llvm::json::Array many;
+    for (int64_t i = 0; i < 20; ++i) {
+        many.push_back(i * 1000);
+    }
+    llvm::json::Value value = llvm::json::Object{{"negative", -33},
+                                                 {"small", -5},
+                                                 {"large", int64_t{1} << 40},
+                                                 {"fraction", 0.25},
+                                                 {"text", std::string(40, 'x')},
+                                                 {"many", std::move(many)},
+                                                 {"nothing", nullptr},
+                                                 {"flag", true}};
+
+    std::string bytes;
+    {
+        llvm::raw_string_ostream out(bytes);
+        MessagePackWriter(out).write(value);
+    }
+    MessagePackReader reader(bytes);
+    CHECK(reader.read() == value);
+    CHECK(reader.atEnd());
+
+    MessagePackReader truncated(llvm::StringRef(bytes).drop_back());
+    CHECK_THROWS_AS(truncated.read(), std::runtime_error);
+}
+
+TEST_CASE("readHeader returns the shard of either format") {
+    TemporaryDirectory directory;
+    auto               json    = (directory.path() / "shard.json").string();
+    auto               msgpack = (directory.path() / "shard.msgpack").string();
+    auto               whole   = (directory.path() / "whole.json").string();
+
+    writeShard(json, ShardInfo{.index = 1, .count = 3});
+    writeShard(msgpack, ShardInfo{.index = 2, .count = 3}, IRFormat::MessagePack);
+    writeShard(whole, std::nullopt);
+
+    CHECK(IRImporter::readHeader(json).version == IRExporter::version);
+    CHECK(IRImporter::readHeader(json).shard == ShardInfo{.index = 1, .count = 3});
+    CHECK(IRImporter::readHeader(msgpack).shard == ShardInfo{.index = 2, .count = 3});
+    CHECK_FALSE(IRImporter::readHeader(whole).shard.has_value());
+}
+
+TEST_CASE("readHeader does not parse the chunks") {
+    TemporaryDirectory directory;
+    auto               path = (directory.path() / "truncated.json").string();
+
+    writeByHand(path, R"({"format": "cppglue-ir", "version": 1, "shard": {"index": 0, "count": 2}, "chunks": [{"structs": )");
+    CHECK(IRImporter::readHeader(path).shard == ShardInfo{.index = 0, .count = 2});
+    CHECK_THROWS_AS(IRImporter::read(path, [](Structs &&, Functions &&) {}, [](Headers &&) {}), std::runtime_error);
+}
+
+TEST_CASE("readHeader rejects files that are not valid IR") {
+    TemporaryDirectory directory;
+    auto               path = (directory.path() / "ir.json").string();
+
+    writeByHand(path, R"({"format": "something-else", "version": 1, "chunks": []})");
+    CHECK_THROWS_AS(IRImporter::readHeader(path), std::runtime_error);
+
+    writeByHand(path, R"({"format": "cppglue-ir", "version": 2, "chunks": []})");
+    CHECK_THROWS_AS(IRImporter::readHeader(path), std::runtime_error);
+
+    writeByHand(path, R"({"format": "cppglue-ir", "version": 1, "shard": {"index": 2, "count": 2}, "chunks": []})");
+    CHECK_THROWS_AS(IRImporter::readHeader(path), std::runtime_error);
+
+    writeByHand(path, R"({"format": "cppglue-ir", "version": 1, "shard": {"index": -1, "count": 2}, "chunks": []})");
+    CHECK_THROWS_AS(IRImporter::readHeader(path), std::runtime_error);
+
+    CHECK_THROWS_AS(IRImporter::readHeader((directory.path() / "missing.json").string()), std::runtime_error);
+}
+
+TEST_CASE("merge only accepts the complete set of shards of one extraction") {
+    TemporaryDirectory directory;
+    auto               path = [&directory](const std::string &fileName) { return (directory.path() / fileName).string(); };
+
+    writeShard(path("0of2.json"), ShardInfo{.index = 0, .count = 2});
+    writeShard(path("0of2-again.json"), ShardInfo{.index = 0, .count = 2});
+    writeShard(path("1of3.json"), ShardInfo{.index = 1, .count = 3});
+    writeShard(path("whole.json"), std::nullopt);
+    writeByHand(path("broken.json"), "{");
+
+    CHECK(runMerge(mergeOf({path("0of2.json")})) != 0);                         // Shard 1 missing
+    CHECK(runMerge(mergeOf({path("0of2.json"), path("0of2-again.json")})) != 0); // Shard 0 twice
+    CHECK(runMerge(mergeOf({path("0of2.json"), path("1of3.json")})) != 0);       // Different extractions
+    CHECK(runMerge(mergeOf({path("0of2.json"), path("whole.json")})) != 0);      // Sharded and unsharded
+    CHECK(runMerge(mergeOf({path("whole.json"), path("broken.json")})) != 0);
+}
+
+TEST_CASE("IRCollector keeps the first copy of every declaration") {
+    IRCollector collector;
+    collector.addDeclarations({point(), color()}, {length()});
+    collector.addDeclarations({point()}, {length(), length(false)});
+    collector.addHeaders({header("point.h")});
+    collector.addHeaders({header("point.h"), header("color.h")});
+
+    auto ir = collector.take();
+    CHECK(ir.structs == Structs{point(), color()});
+    CHECK(ir.functions == Functions{length(), length(false)});
+    CHECK(ir.headers == Headers{header("point.h"), header("color.h")});
+
+    // take() resets the collector
+    collector.addDeclarations({point()}, {});
+    CHECK(collector.take().structs.size() == 1);
+}
+
+TEST_CASE("IRCollector spills beyond its budget and reads the IR back in order") {
+    TemporaryDirectory directory;
+    CollectedIR        ir;
+    {
+        IRCollector collector({.memoryBudget = 1, .spillDirectory = directory.path()});
+        collector.addDeclarations({point()}, {length()});
+        collector.addHeaders({header("point.h")});
+        collector.addDeclarations({point(), color()}, {length(), length(false)});
+        CHECK(collector.spillCount() == 3);
+        CHECK(directory.fileCount() == 1);
+
+        ir = collector.take();
+        CHECK(directory.fileCount() == 0);
+    }
+
+    CHECK(ir.structs == Structs{point(), color()});
+    CHECK(ir.functions == Functions{length(), length(false)});
+    CHECK(ir.headers == Headers{header("point.h")});
+}
+
+TEST_CASE("IRCollector removes its spill file without take()") {
+    TemporaryDirectory directory;
+    {
+        IRCollector collector({.memoryBudget = 1, .spillDirectory = directory.path()});
+        collector.addDeclarations({point()}, {});
+        CHECK(directory.fileCount() == 1);
+    }
+    CHECK(directory.fileCount() == 0);
+}
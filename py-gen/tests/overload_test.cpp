@@ -0,0 +1,104 @@
+#include "py-gen.h"
+
+#include <doctest/doctest.h>
+#include <string>
+
+namespace {
+FieldDeclarationInfo parameter(const std::string &name, TypeInfo::Kind kind, const std::string &spelling) {
+    TypeInfo type;
+    type.kind      = kind;
+    type.spelling  = spelling;
+    type.name      = kind == TypeInfo::Kind::Record ? spelling.substr(0, spelling.find('<')) : "";
+    FieldDeclarationInfo info;
+    info.name.plain     = name;
+    info.name.qualified = name;
+    info.type.plain     = spelling;
+    info.type.qualified = spelling;
+    info.typeIndex      = TypeTable::shared().intern(type);
+    return info;
+}
+
+FunctionInfo function(const std::string &name, std::vector<FieldDeclarationInfo> parameters) {
+    FunctionInfo info;
+    info.name.plain     = name.substr(name.rfind(':') + 1);
+    info.name.qualified = name;
+    info.parameters     = std::move(parameters);
+    return info;
+}
+
+FieldDeclarationInfo text(const std::string &name) {
+    auto info       = parameter(name, TypeInfo::Kind::Record, "std::basic_string<char, std::char_traits<char>, std::allocator<char>>");
+    info.type.plain = "std::string";
+    return info;
+}
+
+GeneratorOptions ordering() {
+    GeneratorOptions options;
+    options.orderOverloads = true;
+    return options;
+}
+
+std::vector<std::string> spellings(const std::vector<const FunctionInfo *> &ordered) {
+    std::vector<std::string> result;
+    for (const auto *funcInfo : ordered) {
+        result.push_back(funcInfo->name.plain + "(" + (funcInfo->parameters.empty() ? "" : funcInfo->parameters[0].type.plain) + ")");
+    }
+    return result;
+}
+} // namespace
+
+TEST_CASE("Overloads are registered bool, floating point, integers, then the rest") {
+    Functions functions{function("test::pick", {parameter("values", TypeInfo::Kind::Record, "std::vector<double>")}),
+                        function("test::other", {}),
+                        function("test::pick", {parameter("value", TypeInfo::Kind::Integer, "long")}),
+                        function("test::pick", {text("text")}),
+                        function("test::pick", {parameter("value", TypeInfo::Kind::Floating, "double")}),
+                        function("test::pick", {parameter("flag", TypeInfo::Kind::Bool, "_Bool")})};
+    auto      overloads = overloadGroups(functions);
+
+    CHECK(spellings(registrationOrder(functions, overloads, ordering())) ==
+          std::vector<std::string>{"pick(_Bool)", "pick(double)", "pick(long)", "pick(std::string)",
+                                   "pick(std::vector<double>)", "other()"});
+    CHECK(spellings(registrationOrder(functions, overloads, GeneratorOptions{})) ==
+          std::vector<std::string>{"pick(std::vector<double>)", "other()", "pick(long)", "pick(std::string)",
+                                   "pick(double)", "pick(_Bool)"});
+}
+
+TEST_CASE("Overloads without interned types are ordered by their spelling") {
+    auto integer       = parameter("value", TypeInfo::Kind::Integer, "std::int64_t");
+    integer.typeIndex  = noType;
+    auto floating      = parameter("value", TypeInfo::Kind::Floating, "double");
+    floating.typeIndex = noType;
+
+    Functions functions{function("pick", {integer}), function("pick", {floating})};
+
+    CHECK(spellings(registrationOrder(functions, overloadGroups(functions), ordering())) ==
+          std::vector<std::string>{"pick(double)", "pick(std::int64_t)"});
+}
+
+TEST_CASE("Only bool parameters with a numeric sibling are bound with noconvert()") {
+    auto      label   = text("label");
+    auto      integer = parameter("other", TypeInfo::Kind::Integer, "int");
+    Functions functions{function("set", {label, parameter("value", TypeInfo::Kind::Bool, "_Bool")}),
+                        function("set", {label, parameter("value", TypeInfo::Kind::Integer, "int")}),
+                        function("set", {label, parameter("value", TypeInfo::Kind::Floating, "double")}),
+                        function("flag", {parameter("value", TypeInfo::Kind::Bool, "_Bool")}),
+                        function("flag", {parameter("value", TypeInfo::Kind::Floating, "float")}),
+                        function("only", {parameter("value", TypeInfo::Kind::Bool, "_Bool")}),
+                        function("mixed", {parameter("value", TypeInfo::Kind::Bool, "_Bool"), label}),
+                        function("mixed", {parameter("value", TypeInfo::Kind::Integer, "int"), integer})};
+    auto      overloads = overloadGroups(functions);
+
+    CHECK_FALSE(isNoConvert(functions[0], 0, overloads, ordering()));
+    CHECK(isNoConvert(functions[0], 1, overloads, ordering()));
+    CHECK_FALSE(isNoConvert(functions[0], 1, overloads, GeneratorOptions{}));
+    // Floating point and integer parameters keep converting
+    CHECK_FALSE(isNoConvert(functions[1], 1, overloads, ordering()));
+    CHECK_FALSE(isNoConvert(functions[2], 1, overloads, ordering()));
+
+    CHECK(isNoConvert(functions[3], 0, overloads, ordering()));
+    CHECK_FALSE(isNoConvert(functions[4], 0, overloads, ordering()));
+    CHECK_FALSE(isNoConvert(functions[5], 0, overloads, ordering()));
+    // The other parameters differ
+    CHECK_FALSE(isNoConvert(functions[6], 0, overloads, ordering()));
+}
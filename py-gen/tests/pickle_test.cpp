@@ -0,0 +1,132 @@
+#include "py-gen.h"
+
+#include <doctest/doctest.h>
+#include <string>
+
+namespace {
+FieldDeclarationInfo field(const std::string &name, const TypeInfo &type) {
+    FieldDeclarationInfo info;
+    info.name.plain     = name;
+    info.name.qualified = name;
+    info.type.plain     = type.spelling;
+    info.type.qualified = type.spelling;
+    info.isPublic       = true;
+    info.typeIndex      = TypeTable::shared().intern(type);
+    return info;
+}
+
+StructInfo record(const std::string &name, std::vector<FieldDeclarationInfo> members) {
+    StructInfo info;
+    info.name.plain     = name.substr(name.rfind(':') + 1);
+    info.name.qualified = name;
+    info.members        = std::move(members);
+    return info;
+}
+
+TypeInfo type(TypeInfo::Kind kind, const std::string &spelling, const std::string &name = {}) {
+    TypeInfo info;
+    info.kind     = kind;
+    info.spelling = spelling;
+    info.name     = name;
+    return info;
+}
+
+GeneratorOptions pickling() {
+    GeneratorOptions options;
+    options.pickle = true;
+    return options;
+}
+} // namespace
+
+TEST_CASE("A struct with a bool field is picklable") {
+    // clang spells bool "_Bool" in canonical C spellings, the kind decides
+    Structs structs{record("alpha::Flags", {field("enabled", type(TypeInfo::Kind::Bool, "_Bool")),
+                                            field("count", type(TypeInfo::Kind::Integer, "int"))})};
+
+    CHECK(picklableStructs(structs, pickling()).contains("alpha::Flags"));
+    CHECK(picklableStructs(structs, GeneratorOptions{}).empty());
+}
+
+TEST_CASE("A struct with a bool field is picklable without interned types") {
+    auto flags                 = record("alpha::Flags", {field("enabled", type(TypeInfo::Kind::Bool, "_Bool"))});
+    flags.members[0].typeIndex = noType;
+
+    CHECK(picklableStructs({flags}, pickling()).contains("alpha::Flags"));
+}
+
+TEST_CASE("A struct is picklable if the structs of its fields are") {
+    auto flags   = type(TypeInfo::Kind::Record, "alpha::Flags", "alpha::Flags");
+    auto pointer = type(TypeInfo::Kind::Pointer, "int *");
+
+    Structs structs{record("alpha::Flags", {field("enabled", type(TypeInfo::Kind::Bool, "_Bool"))}),
+                    record("alpha::Settings", {field("flags", flags), field("scale", type(TypeInfo::Kind::Floating, "double"))}),
+                    record("alpha::Handle", {field("data", pointer)}),
+                    record("alpha::Owner", {field("handle", type(TypeInfo::Kind::Record, "alpha::Handle", "alpha::Handle"))})};
+
+    auto picklable = picklableStructs(structs, pickling());
+    CHECK(picklable.contains("alpha::Flags"));
+    CHECK(picklable.contains("alpha::Settings"));
+    CHECK_FALSE(picklable.contains("alpha::Handle"));
+    CHECK_FALSE(picklable.contains("alpha::Owner"));
+}
+
+TEST_CASE("Only structs whose fields are all public and extracted are picklable") {
+    auto count = type(TypeInfo::Kind::Integer, "int");
+
+    auto hidden               = record("alpha::Hidden", {field("count", count), field("secret", count)});
+    hidden.members[1].isPublic = false;
+    // The filter skipped the private fields
+    auto filtered         = record("alpha::Filtered", {field("count", count)});
+    filtered.hasAllFields = false;
+    // A public field of its own, the others inherited
+    auto derived         = record("alpha::Derived", {field("count", count)});
+    derived.hasAllFields = false;
+
+    auto picklable = picklableStructs({hidden, filtered, derived, record("alpha::Open", {field("count", count)})}, pickling());
+    CHECK(picklable == std::set<std::string>{"alpha::Open"});
+}
+
+TEST_CASE("Vectors and strings are picklable with the default allocator only") {
+    auto flag      = type(TypeInfo::Kind::Bool, "_Bool");
+    auto allocator = type(TypeInfo::Kind::Record, "std::allocator<_Bool>", "std::allocator");
+    auto pool      = type(TypeInfo::Kind::Record, "alpha::Pool<_Bool>", "alpha::Pool");
+    auto character = type(TypeInfo::Kind::Integer, "char");
+
+    auto vector      = type(TypeInfo::Kind::Record, "std::vector<_Bool>", "std::vector");
+    vector.arguments = {TypeTable::shared().intern(flag), TypeTable::shared().intern(allocator)};
+    auto pooled      = type(TypeInfo::Kind::Record, "std::vector<_Bool, alpha::Pool<_Bool>>", "std::vector");
+    pooled.arguments = {TypeTable::shared().intern(flag), TypeTable::shared().intern(pool)};
+    auto string      = type(TypeInfo::Kind::Record, "std::basic_string<char>", "std::basic_string");
+    string.arguments = {TypeTable::shared().intern(character)};
+
+    Structs structs{record("alpha::Bits", {field("bits", vector), field("name", string)}),
+                    record("alpha::Pooled", {field("bits", pooled)})};
+
+    auto picklable = picklableStructs(structs, pickling());
+    CHECK(picklable.contains("alpha::Bits"));
+    CHECK_FALSE(picklable.contains("alpha::Pooled"));
+}
+
+TEST_CASE("Shards pickling the same struct guard its fields") {
+    auto inner        = type(TypeInfo::Kind::Record, "alpha::Inner", "alpha::Inner");
+    auto numbers      = type(TypeInfo::Kind::Record, "std::vector<int>", "std::vector");
+    numbers.arguments = {TypeTable::shared().intern(type(TypeInfo::Kind::Integer, "int"))};
+
+    Structs structs{record("alpha::Inner", {field("values", numbers)}), record("beta::Outer", {field("inner", inner)})};
+
+    ShardPartition partition;
+    for (size_t i = 0; i < structs.size(); ++i) {
+        partition.add(structs[i], i);
+    }
+    auto picklable = picklableStructs(structs, pickling());
+    renderShards(partition, structs, {}, {}, picklable, "module", pickling());
+    REQUIRE(partition.shards().size() == 2);
+
+    // Both shards define the fields of alpha::Inner, each definition is guarded
+    const std::string guard = "#ifndef CPPGLUE_PICKLE_FIELDS_alpha_3A_3AInner\n#define CPPGLUE_PICKLE_FIELDS_alpha_3A_3AInner\n"
+                              "template <> struct Fields<alpha::Inner>";
+    for (const auto &shard : partition.shards()) {
+        CHECK(shard.code.find(guard) != std::string::npos);
+    }
+    CHECK(partition.shards()[1].code.find("#ifndef CPPGLUE_PICKLE_FIELDS_beta_3A_3AOuter\n") != std::string::npos);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <filesystem>
+#include <iterator>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <string>
+
+/**
+ * @brief A directory created for one test case, removed with everything in it at the end of the scope.
+ */
+class TemporaryDirectory {
+  public:
+    TemporaryDirectory() {
+        llvm::SmallString<256> path;
+        if (!llvm::sys::fs::createUniqueDirectory("py-gen-test", path)) {
+            path_ = path.str().str();
+        }
+    }
+
+    ~TemporaryDirectory() {
+        std::error_code ec;
+        std::filesystem::remove_all(path_, ec);
+    }
+
+    TemporaryDirectory(const TemporaryDirectory &)            = delete;
+    TemporaryDirectory &operator=(const TemporaryDirectory &) = delete;
+
+    [[nodiscard]] const std::filesystem::path &path() const { return path_; }
+
+    /**
+     * @brief Number of files in the directory, temporary files left behind show up here.
+     */
+    [[nodiscard]] size_t fileCount() const {
+        return static_cast<size_t>(std::distance(std::filesystem::directory_iterator(path_), std::filesystem::directory_iterator()));
+    }
+
+  private:
+    std::filesystem::path path_;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "include_tracker.hpp"
+#include "visitor.hpp"
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+class ExtractionSession;
+
+/**
+ * @brief Everything extracted by one Session::parse() call.
+ */
+struct ExtractionResult {
+    Structs   structs;
+    Functions functions;
+    Headers   headers;
+};
+
+/**
+ * @brief The extraction session behind cppglue.Session.
+ *
+ * Kept free of clang classes with vtables, so the pybind11 module (compiled with RTTI) can use it while the
+ * implementation is compiled the way LLVM was built.
+ *
+ * parse() runs without the GIL. The ExtractionSession is not thread-safe, so calls on the same session from several
+ * threads run one after the other; parse in parallel with one session per thread.
+ */
+class PythonSession {
+  public:
+    PythonSession();
+    ~PythonSession();
+
+    PythonSession(const PythonSession &)            = delete;
+    PythonSession &operator=(const PythonSession &) = delete;
+
+    /**
+     * @brief Extracts the declarations of the given sources, declarations of headers included by several sources once.
+     *
+     * @param sources Source files, may be empty if compileCommands lists the files to process
+     * @param args Compiler arguments applied to every source, ignored if compileCommands is given
+     * @param compileCommands Optional path to a compile_commands.json
+     * @param workingDirectory Directory relative paths are resolved against, the process working directory by default
+     * @throws std::runtime_error if the compilation database can not be loaded or a source fails to parse
+     */
+    ExtractionResult parse(const std::vector<std::string> &sources, const std::vector<std::string> &args,
+                           const std::optional<std::string> &compileCommands, const std::optional<std::string> &workingDirectory);
+
+    /**
+     * @brief Drops the cached file system state, e.g. after headers were created in searched include directories.
+     */
+    void reset();
+
+  private:
+    std::mutex                         mutex_; // Guards session_
+    std::unique_ptr<ExtractionSession> session_;
+};
@@ -0,0 +1,80 @@
+#include "python_session.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+PYBIND11_MODULE(_cppglue, m) {
+    m.doc() = "In-process access to the declarations cppglue extracts from C++ sources";
+
+    py::class_<DeclarationName>(m, "DeclarationName")
+        .def_readonly("plain", &DeclarationName::plain)
+        .def_readonly("qualified", &DeclarationName::qualified)
+        .def_readonly("namespace", &DeclarationName::namespace_)
+        .def("__repr__", [](const DeclarationName &name) { return "DeclarationName('" + name.qualified + "')"; });
+
+    // Declared before the field binding, FieldDeclarationInfo.functionals holds FunctionInfo objects
+    py::class_<FunctionInfo> functionInfo(m, "FunctionInfo");
+
+    py::class_<FieldDeclarationInfo>(m, "FieldDeclarationInfo")
+        .def_readonly("type", &FieldDeclarationInfo::type)
+        .def_readonly("name", &FieldDeclarationInfo::name)
+        .def_readonly("value", &FieldDeclarationInfo::value)
+        .def_readonly("is_const", &FieldDeclarationInfo::isConst)
+        .def_readonly("is_pointer", &FieldDeclarationInfo::isPointer)
+        .def_readonly("is_reference", &FieldDeclarationInfo::isReference)
+        .def_readonly("is_functional", &FieldDeclarationInfo::isFunctional)
+        .def_readonly("is_public", &FieldDeclarationInfo::isPublic)
+        .def_readonly("functionals", &FieldDeclarationInfo::functionals)
+        .def("__repr__",
+             [](const FieldDeclarationInfo &field) { return "FieldDeclarationInfo('" + field.type.plain + " " + field.name.plain + "')"; });
+
+    py::class_<StructInfo>(m, "StructInfo")
+        .def_readonly("name", &StructInfo::name)
+        .def_readonly("is_enum", &StructInfo::isEnum)
+        .def_readonly("members", &StructInfo::members)
+        .def_readonly("defining_file", &StructInfo::definingFile)
+        .def("__repr__", [](const StructInfo &info) { return "StructInfo('" + info.name.qualified + "')"; });
+
+    functionInfo.def_readonly("name", &FunctionInfo::name)
+        .def_readonly("return_type", &FunctionInfo::returnType)
+        .def_readonly("namespace", &FunctionInfo::namespace_)
+        .def_readonly("is_member_function", &FunctionInfo::isMemberFunction)
+        .def_readonly("is_pure_virtual", &FunctionInfo::isPureVirtual)
+        .def_readonly("is_static", &FunctionInfo::isStatic)
+        .def_readonly("is_const", &FunctionInfo::isConst)
+        .def_readonly("parent", &FunctionInfo::parent)
+        .def_readonly("parameters", &FunctionInfo::parameters)
+        .def_readonly("defining_file", &FunctionInfo::definingFile)
+        .def("__repr__", [](const FunctionInfo &info) { return "FunctionInfo('" + info.name.qualified + "')"; });
+
+    py::class_<Header>(m, "Header")
+        .def_readonly("name", &Header::name)
+        .def_readonly("full_path", &Header::fullPath)
+        .def_readonly("is_system", &Header::isSystem)
+        .def_readonly("is_direct", &Header::isDirect)
+        .def("__repr__", [](const Header &header) { return "Header('" + header.name + "')"; });
+
+    py::class_<ExtractionResult>(m, "ExtractionResult")
+        .def_readonly("structs", &ExtractionResult::structs)
+        .def_readonly("functions", &ExtractionResult::functions)
+        .def_readonly("headers", &ExtractionResult::headers);
+
+    py::class_<PythonSession>(m, "Session", R"doc(
+Parses C++ sources in-process. The session keeps clang's file manager and stat caches alive, so repeated calls
+only pay for what changed since the previous one. parse() releases the GIL; calls on the same session from
+several threads run one after the other, use a session per thread to parse in parallel.
+
+    session = cppglue.Session()
+    result = session.parse(["shapes.h"], args=["-xc++", "-std=c++20"])
+    for struct in result.structs:
+        print(struct.name.qualified, [member.name.plain for member in struct.members])
+)doc")
+        .def(py::init<>())
+        .def("parse", &PythonSession::parse, py::arg("sources") = std::vector<std::string>{},
+             py::arg("args") = std::vector<std::string>{}, py::arg("compile_commands") = std::nullopt,
+             py::arg("working_directory") = std::nullopt, py::call_guard<py::gil_scoped_release>(),
+             "Extracts the declarations of the sources, raises RuntimeError if a source fails to parse")
+        .def("reset", &PythonSession::reset, "Drops the cached file system state");
+}
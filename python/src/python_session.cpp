@@ -0,0 +1,46 @@
+#include "python_session.h"
+
+#include "extraction_session.hpp"
+#include "ir_collector.hpp"
+
+#include <filesystem>
+#include <stdexcept>
+
+PythonSession::PythonSession() : session_(std::make_unique<ExtractionSession>()) {}
+
+PythonSession::~PythonSession() = default;
+
+ExtractionResult PythonSession::parse(const std::vector<std::string> &sources, const std::vector<std::string> &args,
+                                      const std::optional<std::string> &compileCommands,
+                                      const std::optional<std::string> &workingDirectory) {
+    ExtractionRequest request{.sources = sources, .compileArgs = args};
+    if (workingDirectory) {
+        request.workingDirectory = std::filesystem::absolute(*workingDirectory).string();
+    }
+    if (compileCommands) {
+        request.compileCommandsFile = (std::filesystem::path(request.workingDirectory) / *compileCommands).string();
+    }
+
+    // A header's declarations are extracted once per source including it, the collector keeps the first copy
+    IRCollector collector;
+    auto        cb  = [&collector](Structs &&structs, Functions &&functions) {
+        collector.addDeclarations(std::move(structs), std::move(functions));
+    };
+    auto        hcb = [&collector](Headers &&headers) { collector.addHeaders(std::move(headers)); };
+
+    {
+        // Called without the GIL, calls from several Python threads take turns
+        std::lock_guard lock(mutex_);
+        if (session_->run(request, cb, hcb) != 0) {
+            throw std::runtime_error("Extraction failed, see the diagnostics on stderr");
+        }
+    }
+
+    auto [structs, functions, headers] = collector.take();
+    return {.structs = std::move(structs), .functions = std::move(functions), .headers = std::move(headers)};
+}
+
+void PythonSession::reset() {
+    std::lock_guard lock(mutex_);
+    session_->reset();
+}